@@ -0,0 +1,25 @@
+// BENCH_H provides the timing helpers shared by the benchmarks.
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+// bench_now returns a monotonic timestamp in nanoseconds.
+static inline uint64_t bench_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+// bench_report prints one CSV line of
+// benchmark,keycount,layers,ns_per_op,ops_per_sec
+static inline void bench_report(const char *benchmark, int keycount,
+                                int layers, uint64_t ops, uint64_t elapsed_ns) {
+  double ns_per_op = (double)elapsed_ns / ops;
+  printf("%s,%d,%d,%.2f,%.0f\n", benchmark, keycount, layers, ns_per_op,
+         1e9 / ns_per_op);
+}
+
+#endif
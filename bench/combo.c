@@ -0,0 +1,82 @@
+#include "bench.h"
+#include "squirrel.h"
+#include "squirrel_combo.h"
+#include "squirrel_init.h"
+#include "squirrel_key.h"
+#include "squirrel_keymap.h"
+#include "squirrel_quantum.h"
+#include <stdint.h>
+
+// bench: press_key + release_key with COMBOS combos, for keys in no combo,
+// keys that complete a combo, and keys that are held back and then let go.
+
+#define COMBOS 256
+#define ITERATIONS 2000000
+
+static struct key base_keymap[SQUIRREL_KEYCOUNT];
+static struct combo combos[COMBOS];
+
+// setup gives every key a keycode, and makes combo n the keys n / 4 and
+// 64 + n % 4 + 4 * (n / 64), so keys 0 to 79 are in combos and the rest are
+// not.
+static void setup(void) {
+  squirrel_init();
+  for (int i = 0; i < SQUIRREL_KEYCOUNT; i++) {
+    base_keymap[i] = keyboard(0x04 + i % 0x60);
+  }
+  layer_set_keymap(0, base_keymap);
+  layer_set_active(0, true);
+  for (int n = 0; n < COMBOS; n++) {
+    combos[n] = (struct combo){.key = keyboard(0x68)};
+    combo_add_key(&combos[n], n / 4);
+    combo_add_key(&combos[n], 64 + n % 4 + 4 * (n / 64));
+  }
+  combo_set_table(combos, COMBOS);
+}
+
+static void bench_other_key(void) {
+  setup();
+  uint64_t start = bench_now();
+  for (uint32_t i = 0; i < ITERATIONS; i++) {
+    press_key(100);
+    release_key(100);
+  }
+  bench_report("combo_other_key", SQUIRREL_KEYCOUNT, 1, ITERATIONS * 2,
+               bench_now() - start);
+}
+
+static void bench_complete(void) {
+  setup();
+  uint64_t start = bench_now();
+  for (uint32_t i = 0; i < ITERATIONS; i++) {
+    uint16_t n = i % COMBOS;
+    press_key(n / 4);
+    press_key(64 + n % 4 + 4 * (n / 64));
+    release_key(n / 4);
+    release_key(64 + n % 4 + 4 * (n / 64));
+  }
+  bench_report("combo_complete", SQUIRREL_KEYCOUNT, 1, ITERATIONS * 4,
+               bench_now() - start);
+}
+
+static void bench_no_match(void) {
+  setup();
+  uint64_t start = bench_now();
+  for (uint32_t i = 0; i < ITERATIONS; i++) {
+    // Two lowest keys are never in a combo together.
+    uint8_t key_index = i % 63;
+    press_key(key_index);
+    press_key(key_index + 1);
+    release_key(key_index + 1);
+    release_key(key_index);
+  }
+  bench_report("combo_no_match", SQUIRREL_KEYCOUNT, 1, ITERATIONS * 4,
+               bench_now() - start);
+}
+
+int main() {
+  bench_other_key();
+  bench_complete();
+  bench_no_match();
+  return 0;
+}
@@ -0,0 +1,42 @@
+#include "bench.h"
+#include "squirrel.h"
+#include "squirrel_init.h"
+#include "squirrel_key.h"
+#include "squirrel_keymap.h"
+#include "squirrel_quantum.h"
+#include <stdint.h>
+
+// bench: press_key + release_key of each built-in action, to compare
+// dispatching through the actions table with SQUIRREL_SWITCH_DISPATCH.
+
+#ifdef SQUIRREL_SWITCH_DISPATCH
+#define DISPATCH "switch"
+#else
+#define DISPATCH "table"
+#endif
+
+#define ITERATIONS 10000000
+
+static void bench(const char *action, struct key key) {
+  squirrel_init();
+  layer_set_active(0, true);
+  layer_set_key(0, 0, key);
+  uint64_t start = bench_now();
+  for (uint32_t i = 0; i < ITERATIONS; i++) {
+    press_key(0);
+    release_key(0);
+  }
+  uint64_t elapsed = bench_now() - start;
+  char name[64];
+  snprintf(name, sizeof(name), "dispatch_%s_%s", DISPATCH, action);
+  bench_report(name, SQUIRREL_KEYCOUNT, 1, ITERATIONS * 2, elapsed);
+}
+
+int main() {
+  bench("keyboard", keyboard(0x04));
+  bench("keyboard_modifier", keyboard_modifier(0b00000001));
+  bench("consumer", consumer(0x00E9));
+  bench("layer_momentary", layer_momentary(1));
+  bench("nop", nop());
+  return 0;
+}
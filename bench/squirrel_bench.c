@@ -0,0 +1,147 @@
+#include "bench.h"
+#include "squirrel.h"
+#include "squirrel_debounce.h"
+#include "squirrel_init.h"
+#include "squirrel_key.h"
+#include "squirrel_keyboard.h"
+#include "squirrel_keymap.h"
+#include "squirrel_quantum.h"
+#include <stdint.h>
+#include <string.h>
+
+// bench: the hot paths of SQUIRREL for a keyboard of SQUIRREL_KEYCOUNT keys.
+// Benchmarks that do not depend on the layer stack report 0 layers.
+
+#define OPS 2000000
+
+static struct key base_keymap[SQUIRREL_KEYCOUNT];
+
+// setup_layers fills layer 0 with keyboard keys, and activates depth layers
+// of passthrough keys above it.
+static void setup_layers(uint8_t depth) {
+  squirrel_init();
+  for (int i = 0; i < SQUIRREL_KEYCOUNT; i++) {
+    base_keymap[i] = keyboard(0x04 + i % 0x60);
+  }
+  layer_set_keymap(0, base_keymap);
+  for (uint8_t j = 0; j < depth; j++) {
+    layer_set_active(j, true);
+  }
+}
+
+static void bench_init(void) {
+  uint64_t ops = OPS / SQUIRREL_KEYCOUNT / 16 + 1;
+  uint64_t start = bench_now();
+  for (uint64_t i = 0; i < ops; i++) {
+    squirrel_init();
+  }
+  bench_report("squirrel_init", SQUIRREL_KEYCOUNT, 0, ops, bench_now() - start);
+}
+
+static void bench_check_key_idle(void) {
+  setup_layers(1);
+  uint64_t scans = OPS / SQUIRREL_KEYCOUNT + 1;
+  uint64_t start = bench_now();
+  for (uint64_t i = 0; i < scans; i++) {
+    for (int k = 0; k < SQUIRREL_KEYCOUNT; k++) {
+      check_key(k, false);
+    }
+  }
+  bench_report("check_key_idle", SQUIRREL_KEYCOUNT, 1,
+               scans * SQUIRREL_KEYCOUNT, bench_now() - start);
+}
+
+static void bench_check_keys_idle(void) {
+  setup_layers(1);
+  uint32_t bitmap[SQUIRREL_KEYSTATE_WORDS];
+  memset(bitmap, 0, sizeof(bitmap));
+  uint64_t start = bench_now();
+  for (uint64_t i = 0; i < OPS; i++) {
+    check_keys(bitmap);
+  }
+  bench_report("check_keys_idle_scan", SQUIRREL_KEYCOUNT, 1, OPS,
+               bench_now() - start);
+}
+
+static void bench_debounce_idle(const char *name, enum debounce_mode mode) {
+  setup_layers(1);
+  debounce_set_mode(mode, 5);
+  uint32_t bitmap[SQUIRREL_KEYSTATE_WORDS];
+  memset(bitmap, 0, sizeof(bitmap));
+  uint64_t start = bench_now();
+  for (uint64_t i = 0; i < OPS; i++) {
+    debounce_scan(bitmap);
+  }
+  bench_report(name, SQUIRREL_KEYCOUNT, 1, OPS, bench_now() - start);
+  debounce_set_mode(DEBOUNCE_NONE, 0);
+}
+
+static void bench_check_key_toggle(void) {
+  setup_layers(1);
+  uint64_t start = bench_now();
+  for (uint64_t i = 0; i < OPS / 2; i++) {
+    squirrel_key_index_t k = i % SQUIRREL_KEYCOUNT;
+    check_key(k, true);
+    check_key(k, false);
+  }
+  bench_report("check_key_toggle", SQUIRREL_KEYCOUNT, 1, OPS,
+               bench_now() - start);
+}
+
+// bench_press_release presses and releases every key through depth - 1
+// passthrough layers. If cold is true, the resolved layer cache is cleared
+// before every press, to time walking the layer stack.
+static void bench_press_release(uint8_t depth, bool cold) {
+  setup_layers(depth);
+  uint64_t start = bench_now();
+  for (uint64_t i = 0; i < OPS / 2; i++) {
+    squirrel_key_index_t k = i % SQUIRREL_KEYCOUNT;
+    if (cold) {
+      layer_invalidate_cache();
+    }
+    press_key(k);
+    release_key(k);
+  }
+  bench_report(cold ? "press_release_key_uncached" : "press_release_key",
+               SQUIRREL_KEYCOUNT, depth, OPS, bench_now() - start);
+}
+
+static void bench_keyboard_get_keycodes(uint8_t held) {
+  for (int i = 0; i <= 0xFF; i++) {
+    keyboard_deactivate_keycode(i);
+  }
+  for (uint8_t i = 0; i < held; i++) {
+    keyboard_activate_keycode(0x04 + i * 0x20);
+  }
+  uint8_t active_keycodes[6];
+  volatile bool any = false;
+  uint64_t start = bench_now();
+  for (uint64_t i = 0; i < OPS; i++) {
+    any = keyboard_get_keycodes(&active_keycodes);
+  }
+  uint64_t elapsed = bench_now() - start;
+  (void)any;
+  char name[64];
+  snprintf(name, sizeof(name), "keyboard_get_keycodes_%dheld", held);
+  bench_report(name, SQUIRREL_KEYCOUNT, 0, OPS, elapsed);
+}
+
+int main() {
+  bench_init();
+  bench_check_key_idle();
+  bench_check_keys_idle();
+  bench_debounce_idle("debounce_scan_idle_sym_defer", DEBOUNCE_SYM_DEFER);
+  bench_debounce_idle("debounce_scan_idle_sym_defer_pk", DEBOUNCE_SYM_DEFER_PK);
+  bench_debounce_idle("debounce_scan_idle_eager_defer_pk",
+                      DEBOUNCE_EAGER_DEFER_PK);
+  bench_check_key_toggle();
+  uint8_t depths[] = {1, 4, 16};
+  for (uint8_t i = 0; i < sizeof(depths); i++) {
+    bench_press_release(depths[i], false);
+    bench_press_release(depths[i], true);
+  }
+  bench_keyboard_get_keycodes(0);
+  bench_keyboard_get_keycodes(1);
+  bench_keyboard_get_keycodes(6);
+  return 0;
+}
@@ -6,6 +6,20 @@
 enum squirrel_error {
   ERR_NONE = 0,
   ERR_PASSTHROUGH_ON_BOTTOM_LAYER,
+  ERR_UNKNOWN_ACTION,
+  ERR_KEYMAP_OVERLAY_FULL,
+  ERR_COMBO_TABLE_INVALID,
+  ERR_MACRO_INVALID,
+  ERR_MACRO_QUEUE_FULL,
+  ERR_KEYMAP_INVALID,
+  ERR_KEYMAP_TOO_SMALL,
+  ERR_MACRO_PLAYING,
 };
 
+// squirrel_ctx holds all the state of one keyboard, see squirrel_ctx.h. Every
+// function that uses keyboard state has a variant with a _ctx suffix that
+// takes the context as its first argument. The functions without the suffix
+// use squirrel_default_ctx.
+struct squirrel_ctx;
+
 #endif
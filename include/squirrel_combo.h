@@ -0,0 +1,116 @@
+// SQUIRREL_COMBO_H provides combos: keys that perform one action when pressed
+// together within the combo term, instead of their own.
+//
+// Each combo is a bitmap of its keys, laid out like key_states, so a set of
+// pressed keys is matched against a combo a word at a time. Combos are indexed
+// by their lowest key, so a complete match only compares the combos that
+// start with the lowest pressed key, and each key has a bitmap of the indexed
+// combos that contain it, so the combos that could still complete are found
+// 32 at a time.
+#ifndef SQUIRREL_COMBO_H
+#define SQUIRREL_COMBO_H
+
+#include "squirrel.h"
+#include "squirrel_key.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// SQUIRREL_COMBO_CAPACITY is the number of combos a context can index. The
+// index is part of every context, whether combos are used or not. Besides a
+// few bytes per combo, it takes 4 bytes per key for each 32 combos of
+// capacity, rounded up: 160 bytes for 40 keys at the default capacity.
+#ifndef SQUIRREL_COMBO_CAPACITY
+#define SQUIRREL_COMBO_CAPACITY 16
+#endif
+
+// SQUIRREL_COMBO_TERM is how long the keys of a combo have to be pressed
+// within, in squirrel_tick time units, unless changed with combo_set_term.
+#ifndef SQUIRREL_COMBO_TERM
+#define SQUIRREL_COMBO_TERM 50
+#endif
+
+// SQUIRREL_COMBO_BUFFER_SIZE is the number of presses that can be held back
+// while they could still be part of a combo. It is also the most keys a combo
+// can have.
+#ifndef SQUIRREL_COMBO_BUFFER_SIZE
+#define SQUIRREL_COMBO_BUFFER_SIZE 8
+#endif
+
+// SQUIRREL_COMBO_ACTIVE is the number of combos that can be held down at once.
+#ifndef SQUIRREL_COMBO_ACTIVE
+#define SQUIRREL_COMBO_ACTIVE 4
+#endif
+
+// SQUIRREL_COMBO_INDEX_WORDS is the number of 32-bit words needed to hold one
+// bit per indexed combo.
+#define SQUIRREL_COMBO_INDEX_WORDS ((SQUIRREL_COMBO_CAPACITY + 31) / 32)
+
+struct combo {
+  uint32_t keys[SQUIRREL_KEYSTATE_WORDS]; // the keys, laid out like key_states
+  struct key key; // pressed when the combo completes, and released when any
+                  // of its keys is released. It is dispatched on layer 0,
+                  // with the lowest key of the combo as its index, and
+                  // waits behind an undecided tap-hold key like a key does.
+};
+
+// combo_state holds the combo table of a context, its index, and the presses
+// that are held back while they could still complete a combo.
+struct combo_state {
+  const struct combo *combos;
+  uint16_t count;
+  uint16_t term; // 0 means SQUIRREL_COMBO_TERM
+  // index holds the combo numbers sorted by their lowest key, and lowest holds
+  // that key for each entry of index.
+  uint16_t index[SQUIRREL_COMBO_CAPACITY];
+  squirrel_key_index_t lowest[SQUIRREL_COMBO_CAPACITY];
+  // containing holds, for each key, a bitmap of the positions in index of the
+  // combos that contain the key.
+  uint32_t containing[SQUIRREL_KEYCOUNT][SQUIRREL_COMBO_INDEX_WORDS];
+  // members is a bitmap of the keys that are part of any combo. Presses of
+  // other keys are never held back.
+  uint32_t members[SQUIRREL_KEYSTATE_WORDS];
+  // pending is a bitmap of the held back presses, and buffer holds them in the
+  // order they happened.
+  uint32_t pending[SQUIRREL_KEYSTATE_WORDS];
+  squirrel_key_index_t buffer[SQUIRREL_COMBO_BUFFER_SIZE];
+  uint8_t buffered;
+  uint8_t timer;
+  // consumed is a bitmap of the keys that completed a combo and are still
+  // down. Their releases only release the combos in active.
+  uint32_t consumed[SQUIRREL_KEYSTATE_WORDS];
+  uint16_t active[SQUIRREL_COMBO_ACTIVE];
+  uint8_t active_count;
+};
+
+// combo_add_key adds the key at the index to a combo.
+void combo_add_key(struct combo *combo, squirrel_key_index_t key_index);
+
+// combo_set_table replaces the combos with count combos, which are not copied
+// and must outlive their use. Each combo needs from 2 to
+// SQUIRREL_COMBO_BUFFER_SIZE keys. It returns ERR_COMBO_TABLE_INVALID, and
+// leaves combos disabled, if there are more than SQUIRREL_COMBO_CAPACITY combos
+// or a combo has too few or too many keys. A count of 0 disables combos.
+enum squirrel_error combo_set_table(const struct combo *combos,
+                                    uint16_t count);
+enum squirrel_error combo_set_table_ctx(struct squirrel_ctx *ctx,
+                                        const struct combo *combos,
+                                        uint16_t count);
+
+// combo_set_term sets how long the keys of a combo have to be pressed within,
+// in squirrel_tick time units. A term of 0 uses SQUIRREL_COMBO_TERM.
+void combo_set_term(uint16_t term);
+void combo_set_term_ctx(struct squirrel_ctx *ctx, uint16_t term);
+
+// combo_intercept is called by key_event_stage while combos are set. It holds
+// back presses of keys that could still complete a combo, setting held_back,
+// and performs the combo once its keys are all down. Presses that turn out not
+// to be part of a combo are replayed in order.
+//
+// A combo completes as soon as its keys are down, unless a longer combo with
+// the same lowest key could still complete. Then it waits for the term to
+// pass, another key to be pressed, or one of its keys to be released.
+enum squirrel_error combo_intercept(struct squirrel_ctx *ctx,
+                                    squirrel_key_index_t key_index,
+                                    bool pressed, bool *held_back);
+
+#endif
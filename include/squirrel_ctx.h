@@ -0,0 +1,83 @@
+// SQUIRREL_CTX_H defines squirrel_ctx, which holds all the state of one
+// keyboard, so that many keyboards can run in one program, for example to
+// simulate thousands of them across threads. Functions with a _ctx suffix
+// work on the context they are given, and the functions without it work on
+// squirrel_default_ctx.
+//
+// Contexts are independent: different contexts can be used from different
+// threads at the same time without locking. custom_actions and the
+// instrumentation clock are shared by every context.
+#ifndef SQUIRREL_CTX_H
+#define SQUIRREL_CTX_H
+
+#include "squirrel.h"
+#include "squirrel_combo.h"
+#include "squirrel_debounce.h"
+#include "squirrel_event.h"
+#include "squirrel_instrument.h"
+#include "squirrel_key.h"
+#include "squirrel_keyboard.h"
+#include "squirrel_macro.h"
+#include "squirrel_quantum.h"
+#include "squirrel_report.h"
+#include "squirrel_timer.h"
+#include <stdint.h>
+
+struct squirrel_ctx {
+  // The state used on every scan and every key press comes first, so that it
+  // shares as few cache lines as possible.
+
+  // key_states is a bitmap that represents the state of each key. The state
+  // of key n is bit (n % 32) of word (n / 32). Used by check_key and
+  // check_keys to determine if a key is pressed or released.
+  uint32_t key_states[SQUIRREL_KEYSTATE_WORDS];
+  // held_keys is a bitmap, laid out like key_states, of the keys that are held
+  // down on the layer recorded in held_from_layer. Both are only modified by
+  // SQUIRREL.
+  uint32_t held_keys[SQUIRREL_KEYSTATE_WORDS];
+  // resolved_layers_valid has a bit set, laid out like key_states, for each
+  // key whose entry in resolved_layers is valid.
+  uint32_t resolved_layers_valid[SQUIRREL_KEYSTATE_WORDS];
+  // active_layers is a bitmask of the active layers, where bit n is set if
+  // layer n is active. The highest active layer is the highest set bit.
+  squirrel_layer_mask_t active_layers;
+  // consumer_code is the currently active consumer code. Only one consumer
+  // code can be active at a time.
+  uint16_t consumer_code;
+  // keyboard_report holds the active keycodes and modifiers. It is always
+  // kept in the NKRO layout, so it can be sent over USB without any
+  // translation.
+  struct keyboard_nkro_report keyboard_report;
+  // resolved_layers holds the result of resolve_layer for each key.
+  uint8_t resolved_layers[SQUIRREL_KEYCOUNT];
+  // held_from_layer holds the layer each held key was pressed on, so that it
+  // is released on the same layer even if the active layers change while it
+  // is held. It is LAYER_NONE for a key that was released early because its
+  // key changed while it was held. It is only meaningful for keys set in
+  // held_keys.
+  uint8_t held_from_layer[SQUIRREL_KEYCOUNT];
+  // layers is a list of all the layers in the keyboard.
+  struct layer layers[SQUIRREL_LAYER_COUNT];
+
+  // The state below is only used when a keymap is edited, a report is sent,
+  // or by the optional modules.
+  struct keymap_overlay overlay;
+  enum keyboard_report_mode keyboard_report_mode;
+  struct keyboard_boot_report keyboard_boot_report;
+  struct report_state report;
+  struct debounce_state debounce;
+  struct event_queue events;
+  struct timer_wheel timers;
+  struct tap_hold_state tap_hold;
+  struct combo_state combos;
+  struct macro_state macros;
+#ifdef SQUIRREL_INSTRUMENTATION
+  struct instrument_stats instrument;
+#endif
+};
+
+// squirrel_default_ctx is the context used by every function without a _ctx
+// suffix.
+extern struct squirrel_ctx squirrel_default_ctx;
+
+#endif
@@ -0,0 +1,58 @@
+// SQUIRREL_DEBOUNCE_H provides debouncing of raw matrix scans, in front of
+// check_keys. Every key is debounced at once using bit-parallel counters over
+// packed state words, so a scan costs a few word operations per 32 keys.
+#ifndef SQUIRREL_DEBOUNCE_H
+#define SQUIRREL_DEBOUNCE_H
+
+#include "squirrel.h"
+#include "squirrel_key.h"
+#include <stdint.h>
+
+// DEBOUNCE_MAX_WINDOW is the longest supported debounce window, in scans.
+#define DEBOUNCE_MAX_WINDOW 15
+
+enum debounce_mode {
+  // DEBOUNCE_NONE passes every scan straight to check_keys (default).
+  DEBOUNCE_NONE = 0,
+  // DEBOUNCE_SYM_DEFER applies a scan once the whole matrix has read the same
+  // for window scans in a row.
+  DEBOUNCE_SYM_DEFER,
+  // DEBOUNCE_SYM_DEFER_PK changes each key once it has read its new state for
+  // window scans in a row, using a counter per key.
+  DEBOUNCE_SYM_DEFER_PK,
+  // DEBOUNCE_EAGER_DEFER_PK presses keys as soon as they read pressed, and
+  // releases each key once it has read released for window scans in a row.
+  DEBOUNCE_EAGER_DEFER_PK,
+};
+
+// DEBOUNCE_COUNTER_BITS is the width of the per key counters, enough to count
+// to DEBOUNCE_MAX_WINDOW.
+#define DEBOUNCE_COUNTER_BITS 4
+
+// debounce_state holds the debounce settings and counters of a context.
+struct debounce_state {
+  enum debounce_mode mode;
+  uint8_t window;
+  // counters holds one counter per key, as vertical bit planes: bit n of a
+  // key's counter is the key's bit in counters[n]. This lets every key in a
+  // word be counted at once.
+  uint32_t counters[DEBOUNCE_COUNTER_BITS][SQUIRREL_KEYSTATE_WORDS];
+  // last_raw and stable_scans are used by DEBOUNCE_SYM_DEFER.
+  uint32_t last_raw[SQUIRREL_KEYSTATE_WORDS];
+  uint8_t stable_scans;
+};
+
+// debounce_set_mode selects the debounce algorithm and its window in scans,
+// which is limited to DEBOUNCE_MAX_WINDOW. A window of 0 or 1 applies
+// changes on the first scan that shows them. All debounce counters are reset.
+void debounce_set_mode(enum debounce_mode mode, uint8_t window);
+void debounce_set_mode_ctx(struct squirrel_ctx *ctx, enum debounce_mode mode,
+                           uint8_t window);
+
+// debounce_scan debounces a raw scan, laid out like key_states, and passes the
+// debounced state to check_keys. It should be called once per scan tick.
+enum squirrel_error debounce_scan(const uint32_t *raw);
+enum squirrel_error debounce_scan_ctx(struct squirrel_ctx *ctx,
+                                      const uint32_t *raw);
+
+#endif
@@ -0,0 +1,66 @@
+// SQUIRREL_EVENT_H provides a queue of key events, so that matrix scanning can
+// happen in an interrupt or on another core while the keymap is processed in
+// the main loop. The queue is lock-free, with one producer and one consumer.
+#ifndef SQUIRREL_EVENT_H
+#define SQUIRREL_EVENT_H
+
+#include "squirrel.h"
+#include "squirrel_key.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// SQUIRREL_EVENT_QUEUE_CAPACITY is the number of events the queue can hold. It
+// must be a power of two.
+#ifndef SQUIRREL_EVENT_QUEUE_CAPACITY
+#define SQUIRREL_EVENT_QUEUE_CAPACITY 64
+#endif
+
+struct key_event {
+  uint32_t timestamp; // when the event happened, in any unit
+  squirrel_key_index_t key_index;  // the key that changed
+  bool pressed;       // true if the key was pressed, false if released
+};
+
+// event_queue holds the queued events of a context. head and tail count the
+// events ever written and read. Only the producer writes head and overflows,
+// and only the consumer writes tail, so plain atomic loads and stores are
+// enough, even on cores without atomic read-modify-write.
+struct event_queue {
+  struct key_event events[SQUIRREL_EVENT_QUEUE_CAPACITY];
+  atomic_uint_fast32_t head;
+  atomic_uint_fast32_t tail;
+  atomic_uint_fast32_t overflows;
+  uint32_t event_time; // timestamp of the event being processed
+};
+
+// squirrel_enqueue_event adds a key event to the queue. It is safe to call from
+// an interrupt or another core, as long as only one context produces events.
+// If the queue is full the event is dropped, the overflow counter is
+// incremented, and false is returned.
+bool squirrel_enqueue_event(squirrel_key_index_t key_index, bool pressed,
+                            uint32_t timestamp);
+bool squirrel_enqueue_event_ctx(struct squirrel_ctx *ctx,
+                                squirrel_key_index_t key_index, bool pressed,
+                                uint32_t timestamp);
+
+// squirrel_process_events takes up to max_events events from the queue (or all
+// of them if max_events is 0) and passes each one to check_key. It must only be
+// called from one context. If check_key returns an error, processing stops
+// and the error is returned. The event that failed is consumed, as check_key
+// has already recorded its key state; the events after it stay in the queue.
+enum squirrel_error squirrel_process_events(uint16_t max_events);
+enum squirrel_error squirrel_process_events_ctx(struct squirrel_ctx *ctx,
+                                                uint16_t max_events);
+
+// squirrel_event_time returns the timestamp of the event being processed, or
+// of the last processed event.
+uint32_t squirrel_event_time(void);
+uint32_t squirrel_event_time_ctx(struct squirrel_ctx *ctx);
+
+// squirrel_event_overflows returns the number of events dropped because the
+// queue was full.
+uint32_t squirrel_event_overflows(void);
+uint32_t squirrel_event_overflows_ctx(struct squirrel_ctx *ctx);
+
+#endif
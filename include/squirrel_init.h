@@ -1,5 +1,10 @@
 #ifndef SQUIRREL_INIT_H
 #define SQUIRREL_INIT_H
+#include "squirrel.h"
 enum squirrel_error
 squirrel_init(void); // Initialize the keyboard with the total number of keys.
+// squirrel_init_ctx resets every piece of state in ctx, the same way
+// squirrel_init resets squirrel_default_ctx. It must be called on a context
+// before it is used, unless it is zero initialized already.
+enum squirrel_error squirrel_init_ctx(struct squirrel_ctx *ctx);
 #endif
@@ -0,0 +1,90 @@
+// SQUIRREL_INSTRUMENT_H provides optional counters and timings for the hot
+// paths of SQUIRREL, for finding out where the time goes when a keyboard feels
+// slow. It is only compiled in if SQUIRREL_INSTRUMENTATION is defined;
+// otherwise the SQUIRREL_INSTRUMENT_* macros expand to nothing.
+//
+// The counters are kept in each squirrel_ctx, so contexts on different threads
+// do not share them. The clock is shared, and should be set before any context
+// is used.
+#ifndef SQUIRREL_INSTRUMENT_H
+#define SQUIRREL_INSTRUMENT_H
+
+#ifdef SQUIRREL_INSTRUMENTATION
+
+#include "squirrel_key.h"
+#include <stdint.h>
+
+// instrument_point identifies an instrumented hot path.
+enum instrument_point {
+  INSTRUMENT_PRESS_KEY = 0,
+  INSTRUMENT_RELEASE_KEY,
+  INSTRUMENT_PASSTHROUGH, // walking the layers to resolve a key
+  INSTRUMENT_POINT_COUNT,
+};
+
+// instrument_timing counts the calls to a hot path, and how long they took in
+// ticks of the instrument clock. The mean duration is total / calls.
+struct instrument_timing {
+  uint32_t calls;
+  uint32_t min;
+  uint32_t max;
+  uint64_t total;
+};
+
+struct instrument_stats {
+  struct instrument_timing points[INSTRUMENT_POINT_COUNT];
+  // dispatches times the press and release functions of each action,
+  // indexed by the key's action for built-in actions, and by
+  // ACTION_BUILTIN_COUNT + n for ACTION_CUSTOM + n.
+  struct instrument_timing
+      dispatches[ACTION_BUILTIN_COUNT + SQUIRREL_CUSTOM_ACTION_COUNT];
+  // max_passthrough_depth is the most passthrough keys skipped while resolving
+  // a single key.
+  uint8_t max_passthrough_depth;
+};
+
+// instrument_clock returns the current time in any unit, for example a cycle
+// counter. It is expected to wrap around at 2^32.
+typedef uint32_t (*instrument_clock)(void);
+
+// instrument_set_clock sets the clock used for timings by every context.
+// Without a clock only the calls are counted.
+void instrument_set_clock(instrument_clock clock);
+// instrument_snapshot copies the current counters into stats.
+void instrument_snapshot(struct instrument_stats *stats);
+void instrument_snapshot_ctx(struct squirrel_ctx *ctx,
+                             struct instrument_stats *stats);
+// instrument_reset clears all counters.
+void instrument_reset(void);
+void instrument_reset_ctx(struct squirrel_ctx *ctx);
+
+// instrument_start returns the current time of the instrument clock.
+uint32_t instrument_start(void);
+// instrument_stop records a call to the hot path that started at start.
+void instrument_stop(struct squirrel_ctx *ctx, enum instrument_point point,
+                     uint32_t start);
+// instrument_stop_dispatch records a dispatch of the action that started at
+// start.
+void instrument_stop_dispatch(struct squirrel_ctx *ctx, uint16_t action,
+                              uint32_t start);
+// instrument_depth records the number of passthrough keys skipped while
+// resolving a key.
+void instrument_depth(struct squirrel_ctx *ctx, uint8_t depth);
+
+#define SQUIRREL_INSTRUMENT_START(name) uint32_t name = instrument_start()
+#define SQUIRREL_INSTRUMENT_STOP(ctx, point, name)                             \
+  instrument_stop(ctx, point, name)
+#define SQUIRREL_INSTRUMENT_STOP_DISPATCH(ctx, action, name)                   \
+  instrument_stop_dispatch(ctx, action, name)
+#define SQUIRREL_INSTRUMENT_DEPTH(ctx, depth) instrument_depth(ctx, depth)
+
+#else
+
+#define SQUIRREL_INSTRUMENT_START(name)
+#define SQUIRREL_INSTRUMENT_STOP(ctx, point, name)
+#define SQUIRREL_INSTRUMENT_STOP_DISPATCH(ctx, action, name)
+#define SQUIRREL_INSTRUMENT_DEPTH(ctx, depth)
+
+#endif
+
+#endif
@@ -1,35 +1,132 @@
 #ifndef SQUIRREL_KEY_H
 #define SQUIRREL_KEY_H
+#include "squirrel.h"
 #include <stdbool.h>
 #include <stdint.h>
 
-typedef enum squirrel_error (*keyfunc)(uint8_t, uint8_t, void *);
+// squirrel_key_index_t indexes the keys of the keyboard. It is only as wide as
+// SQUIRREL_KEYCOUNT needs: 8 bits for up to 256 keys, 16 bits above that.
+#if SQUIRREL_KEYCOUNT > 256
+typedef uint16_t squirrel_key_index_t;
+#else
+typedef uint8_t squirrel_key_index_t;
+#endif
+
+// keyfunc is called with the context of the keyboard the key belongs to, the
+// layer the key was found on, the key's index and the key's argument.
+typedef enum squirrel_error (*keyfunc)(struct squirrel_ctx *, uint8_t,
+                             squirrel_key_index_t, uint16_t);
+
+// key_action identifies what a key does. The functions behind each built-in
+// action are listed in squirrel_quantum.h. The numbers are stored in keymaps,
+// see squirrel_keymap_format.h, so they never change: new built-in actions
+// take the next number before ACTION_BUILTIN_COUNT, and custom actions start
+// at a fixed ACTION_CUSTOM.
+enum key_action {
+  ACTION_PASSTHROUGH = 0, // zero, so that an empty layer passes through
+  ACTION_NOP = 1,
+  ACTION_KEYBOARD = 2,
+  ACTION_KEYBOARD_MODIFIER = 3,
+  ACTION_CONSUMER = 4,
+  ACTION_LAYER_MOMENTARY = 5,
+  ACTION_LAYER_TOGGLE = 6,
+  ACTION_LAYER_SOLO = 7,
+  ACTION_MOD_TAP = 8,   // a keycode when tapped, a modifier when held
+  ACTION_LAYER_TAP = 9, // a keycode when tapped, a momentary layer when held
+  ACTION_MACRO = 10,    // queues a macro, see squirrel_macro.h
+  ACTION_BUILTIN_COUNT, // one past the last built-in action
+  ACTION_CUSTOM = 0x8000, // ACTION_CUSTOM + n uses custom_actions[n]
+};
 
 struct key {
-  keyfunc pressed;         // called when the key is pressed
-  keyfunc released;        // called when the key is released
-  void *pressed_argument;  // argument to pass to pressed
-  void *released_argument; // argument to pass to released
+  uint16_t action;   // the key_action performed by the key
+  uint16_t argument; // argument to pass to the action
 };
 
+// action holds the functions that implement an action.
+struct action {
+  keyfunc pressed;  // called when the key is pressed
+  keyfunc released; // called when the key is released
+};
+
+#ifndef SQUIRREL_CUSTOM_ACTION_COUNT
+#define SQUIRREL_CUSTOM_ACTION_COUNT 16
+#endif
+
+// custom_actions holds user-defined actions, for anything the built-in actions
+// cannot do. A key uses custom_actions[n] if its action is ACTION_CUSTOM + n.
+// They are shared by every context.
+extern struct action custom_actions[SQUIRREL_CUSTOM_ACTION_COUNT];
+
+// dispatch_press calls the pressed function of the key's action. If
+// SQUIRREL_SWITCH_DISPATCH is defined, built-in actions are handled by a switch
+// instead of an indirect call through the actions table, and only custom
+// actions go through a function pointer.
+enum squirrel_error dispatch_press(struct key key, uint8_t layer,
+                                   squirrel_key_index_t key_index);
+enum squirrel_error dispatch_press_ctx(struct squirrel_ctx *ctx, struct key key,
+                                       uint8_t layer,
+                                       squirrel_key_index_t key_index);
+// dispatch_release calls the released function of the key's action, in the
+// same way as dispatch_press.
+enum squirrel_error dispatch_release(struct key key, uint8_t layer,
+                                     squirrel_key_index_t key_index);
+enum squirrel_error dispatch_release_ctx(struct squirrel_ctx *ctx,
+                                         struct key key, uint8_t layer,
+                                         squirrel_key_index_t key_index);
+
 void copy_key(
     struct key *source,
     struct key *destination); // Copy the values from one key to another.
-enum squirrel_error press_key(
-    uint8_t key_index); // Press the key at the index in the appropriate layer.
 enum squirrel_error
-release_key(uint8_t key_index); // Release the key at the index in the
-                                // appropriate layer.
+press_key(squirrel_key_index_t key_index); // Press the key at the index in the
+                                           // appropriate layer.
+enum squirrel_error press_key_ctx(struct squirrel_ctx *ctx,
+                                  squirrel_key_index_t key_index);
+enum squirrel_error
+release_key(squirrel_key_index_t key_index); // Release the key at the index in
+                                             // the appropriate layer.
+enum squirrel_error release_key_ctx(struct squirrel_ctx *ctx,
+                                    squirrel_key_index_t key_index);
 
-// key_states is an array of booleans that represent the state of each key. Used
-// by check_key to determine if a key is pressed or released.
-extern bool key_states[SQUIRREL_KEYCOUNT];
+// key_stage is a step a press or release goes through. Combos, then an
+// undecided tap-hold key, can hold events back before they are dispatched.
+enum key_stage {
+  KEY_STAGE_COMBO = 0,
+  KEY_STAGE_TAP_HOLD,
+  KEY_STAGE_DISPATCH,
+};
+
+// key_event_stage presses or releases the key at the index, starting from the
+// given stage. press_key and release_key start from KEY_STAGE_COMBO. A module
+// that held an event back replays it from the stage after its own, or from its
+// own once it is no longer holding events back.
+enum squirrel_error key_event_stage(squirrel_key_index_t key_index,
+                                    bool pressed, enum key_stage stage);
+enum squirrel_error key_event_stage_ctx(struct squirrel_ctx *ctx,
+                                        squirrel_key_index_t key_index,
+                                        bool pressed, enum key_stage stage);
+
+// SQUIRREL_KEYSTATE_WORDS is the number of 32-bit words needed to hold one bit
+// per key.
+#define SQUIRREL_KEYSTATE_WORDS ((SQUIRREL_KEYCOUNT + 31) / 32)
 
 // check_key compares the state of the key at the index to the key_states array
 // to determine if the key is pressed or released, and calls the appropriate
 // function.
-enum squirrel_error check_key(uint8_t key_index,
+enum squirrel_error check_key(squirrel_key_index_t key_index,
                               bool is_pressed); // Check if the key at the
                                                 // index is pressed or
                                                 // released.
+enum squirrel_error check_key_ctx(struct squirrel_ctx *ctx,
+                                  squirrel_key_index_t key_index,
+                                  bool is_pressed);
+
+// check_keys compares a whole scan to the key_states bitmap, one word at a
+// time, and calls press_key or release_key only for the keys that changed.
+// The bitmap must be laid out like key_states, and hold
+// SQUIRREL_KEYSTATE_WORDS words. Bits past SQUIRREL_KEYCOUNT are ignored.
+enum squirrel_error check_keys(const uint32_t *bitmap);
+enum squirrel_error check_keys_ctx(struct squirrel_ctx *ctx,
+                                   const uint32_t *bitmap);
 #endif
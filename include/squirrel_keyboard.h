@@ -2,26 +2,75 @@
 #ifndef SQUIRREL_KEYBOARD_H
 #define SQUIRREL_KEYBOARD_H
 
+#include "squirrel.h"
 #include <stdbool.h>
 #include <stdint.h>
 
-extern bool keyboard_keycodes[256];
-extern uint8_t keyboard_modifiers;
+// keyboard_nkro_report is laid out exactly like a USB HID N-key rollover
+// keyboard report: a modifier byte followed by a 256 bit bitmap of keycodes,
+// where keycode n is bit (n % 8) of byte (n / 8).
+struct keyboard_nkro_report {
+  uint8_t modifiers;
+  uint8_t keycodes[32];
+};
+
+// keyboard_boot_report is laid out exactly like a USB HID boot keyboard
+// report, which can hold up to 6 keycodes.
+struct keyboard_boot_report {
+  uint8_t modifiers;
+  uint8_t reserved;
+  uint8_t keycodes[6];
+};
+
+// keyboard_report_mode selects which report keyboard_get_report returns.
+enum keyboard_report_mode {
+  KEYBOARD_REPORT_MODE_BOOT = 0, // 6 key rollover boot report (default)
+  KEYBOARD_REPORT_MODE_NKRO,     // N key rollover bitmap report
+};
 
 // keyboard_activate_keycode marks the provided keycode as active.
 void keyboard_activate_keycode(uint8_t keycode);
+void keyboard_activate_keycode_ctx(struct squirrel_ctx *ctx, uint8_t keycode);
 // keyboard_deactivate_keycode marks the provided keycode as inactive.
 void keyboard_deactivate_keycode(uint8_t keycode);
+void keyboard_deactivate_keycode_ctx(struct squirrel_ctx *ctx,
+                                     uint8_t keycode);
+// keyboard_get_keycode returns true if the provided keycode is active.
+bool keyboard_get_keycode(uint8_t keycode);
+bool keyboard_get_keycode_ctx(struct squirrel_ctx *ctx, uint8_t keycode);
 // keyboard_get_keycodes populates the provided array with the first 6 active
 // keycodes. 6 is the maximum number of keycodes that can be sent over USB HID.
 // If there are no keycodes, the function will return false.
 bool keyboard_get_keycodes(uint8_t (*active_keycodes)[6]);
+bool keyboard_get_keycodes_ctx(struct squirrel_ctx *ctx,
+                               uint8_t (*active_keycodes)[6]);
 
 // keyboard_activate_modifier marks the provided modifier as active.
 void keyboard_activate_modifier(uint8_t modifier);
+void keyboard_activate_modifier_ctx(struct squirrel_ctx *ctx,
+                                    uint8_t modifier);
 // keyboard_deactivate_modifier marks the provided modifier as inactive.
 void keyboard_deactivate_modifier(uint8_t modifier);
+void keyboard_deactivate_modifier_ctx(struct squirrel_ctx *ctx,
+                                      uint8_t modifier);
 // keyboard_get_modifiers returns a bitfield of active modifiers.
 uint8_t keyboard_get_modifiers();
+uint8_t keyboard_get_modifiers_ctx(struct squirrel_ctx *ctx);
+
+// keyboard_set_report_mode changes the report returned by keyboard_get_report.
+void keyboard_set_report_mode(enum keyboard_report_mode mode);
+void keyboard_set_report_mode_ctx(struct squirrel_ctx *ctx,
+                                  enum keyboard_report_mode mode);
+// keyboard_get_report_mode returns the current report mode.
+enum keyboard_report_mode keyboard_get_report_mode();
+enum keyboard_report_mode
+keyboard_get_report_mode_ctx(struct squirrel_ctx *ctx);
+// keyboard_get_report points report at a report for the current report mode,
+// and returns its length in bytes. In NKRO mode this is keyboard_report itself,
+// so no copy is made. In boot mode a keyboard_boot_report is built from the
+// first 6 active keycodes. The report stays valid until the next call.
+uint8_t keyboard_get_report(const uint8_t **report);
+uint8_t keyboard_get_report_ctx(struct squirrel_ctx *ctx,
+                                const uint8_t **report);
 
 #endif
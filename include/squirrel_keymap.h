@@ -10,4 +10,38 @@ struct key passthrough(void);
 struct key layer_momentary(uint8_t layer);
 struct key layer_toggle(uint8_t layer);
 struct key layer_solo(uint8_t layer);
+// mod_tap returns a key that types keycode when tapped, and holds modifier
+// when held. See tap_hold_set_mode for how taps and holds are told apart.
+struct key mod_tap(uint8_t modifier, uint8_t keycode);
+// layer_tap returns a key that types keycode when tapped, and activates the
+// layer while held.
+struct key layer_tap(uint8_t layer, uint8_t keycode);
+// macro returns a key that plays the macro at the index when pressed. See
+// macro_set_table.
+struct key macro(uint8_t index);
+// custom returns a key that calls custom_actions[index] with the argument.
+struct key custom(uint8_t index, uint16_t argument);
+
+// The KEY_ macros build the same keys as the functions above as constant
+// initializers, so that a base keymap can be a static const table in flash:
+//   static const struct key base[SQUIRREL_KEYCOUNT] = {KEY_KEYBOARD(0x04)};
+#define KEY_NOP {.action = ACTION_NOP}
+#define KEY_KEYBOARD(keycode) {.action = ACTION_KEYBOARD, .argument = (keycode)}
+#define KEY_KEYBOARD_MODIFIER(modifier)                                        \
+  {.action = ACTION_KEYBOARD_MODIFIER, .argument = (modifier)}
+#define KEY_CONSUMER(consumer)                                                 \
+  {.action = ACTION_CONSUMER, .argument = (consumer)}
+#define KEY_PASSTHROUGH {.action = ACTION_PASSTHROUGH}
+#define KEY_LAYER_MOMENTARY(layer)                                             \
+  {.action = ACTION_LAYER_MOMENTARY, .argument = (layer)}
+#define KEY_LAYER_TOGGLE(layer)                                                \
+  {.action = ACTION_LAYER_TOGGLE, .argument = (layer)}
+#define KEY_LAYER_SOLO(layer) {.action = ACTION_LAYER_SOLO, .argument = (layer)}
+#define KEY_MOD_TAP(modifier, keycode)                                         \
+  {.action = ACTION_MOD_TAP, .argument = (modifier) << 8 | (keycode)}
+#define KEY_LAYER_TAP(layer, keycode)                                          \
+  {.action = ACTION_LAYER_TAP, .argument = (layer) << 8 | (keycode)}
+#define KEY_MACRO(index) {.action = ACTION_MACRO, .argument = (index)}
+#define KEY_CUSTOM(index, arg)                                                 \
+  {.action = ACTION_CUSTOM + (index), .argument = (arg)}
 #endif
@@ -0,0 +1,76 @@
+// SQUIRREL_KEYMAP_FORMAT_H provides a compact binary format for whole keymaps,
+// so a layout can be stored in flash or EEPROM, or in a file on the host, and
+// switched at runtime.
+//
+// keymap_load uses the buffer in place: each layer's keys point into it, so
+// loading a layout only sets two pointers per layer, however many keys there
+// are. keymap_save writes the current layers out, runtime edits included.
+//
+// The format is little endian, and every section is 4 byte aligned:
+//   header, 16 bytes:
+//     0  "SQKM"
+//     4  uint16 KEYMAP_FORMAT_VERSION
+//     6  uint16 number of keys, which must be SQUIRREL_KEYCOUNT
+//     8  uint8 number of layers, at most SQUIRREL_LAYER_COUNT
+//     9  3 bytes of 0
+//     12 uint32 size of the whole keymap in bytes
+//   then a layer table, 8 bytes per layer:
+//     0  uint8 keymap_layer_kind
+//     1  1 byte of 0
+//     2  uint16 number of keys stored for the layer
+//     4  uint32 offset of the layer's keys from the start of the keymap
+//   then the keys of each layer. A dense layer has SQUIRREL_KEYCOUNT keys. A
+//   sparse layer has SQUIRREL_KEYSTATE_WORDS uint32 words of a bitmap laid out
+//   like key_states of the keys it has, then those keys in index order. Each
+//   key is a uint16 key_action and a uint16 argument, like struct key.
+//
+// Actions are stored as their key_action number, which never changes.
+#ifndef SQUIRREL_KEYMAP_FORMAT_H
+#define SQUIRREL_KEYMAP_FORMAT_H
+
+#include "squirrel.h"
+#include "squirrel_key.h"
+#include "squirrel_quantum.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define KEYMAP_FORMAT_VERSION 1
+
+#define KEYMAP_FORMAT_HEADER_SIZE 16
+#define KEYMAP_FORMAT_LAYER_SIZE 8
+
+// KEYMAP_FORMAT_MAX_SIZE is the most bytes keymap_save can need.
+#define KEYMAP_FORMAT_MAX_SIZE                                                 \
+  (KEYMAP_FORMAT_HEADER_SIZE +                                                 \
+   SQUIRREL_LAYER_COUNT *                                                      \
+       (KEYMAP_FORMAT_LAYER_SIZE + SQUIRREL_KEYCOUNT * sizeof(struct key)))
+
+// keymap_layer_kind tells how a layer is stored.
+enum keymap_layer_kind {
+  KEYMAP_LAYER_EMPTY = 0, // every key passes through, and no keys are stored
+  KEYMAP_LAYER_DENSE,
+  KEYMAP_LAYER_SPARSE,
+};
+
+// keymap_load makes the keymap in buffer the base keymap of every layer, and
+// forgets all runtime edits. Layers past the ones in the keymap pass through.
+// The buffer is not copied, so it must outlive its use, and be 4 byte aligned.
+// The active layers are left alone. It returns ERR_KEYMAP_INVALID, and changes
+// nothing, if the keymap is malformed, was saved for another key count, has too
+// many layers or a key that names a layer past them, or the buffer is
+// misaligned.
+enum squirrel_error keymap_load(const void *buffer, size_t size);
+enum squirrel_error keymap_load_ctx(struct squirrel_ctx *ctx,
+                                    const void *buffer, size_t size);
+
+// keymap_save writes every layer, as seen by layer_get_key, into buffer, and
+// sets written to the number of bytes used. Each layer is stored in whichever
+// of the dense and sparse forms is smaller, and layers past the last one with
+// keys are left out. KEYMAP_FORMAT_MAX_SIZE bytes are always enough. If the
+// keymap does not fit, it returns ERR_KEYMAP_TOO_SMALL, with written set to
+// the size needed.
+enum squirrel_error keymap_save(void *buffer, size_t size, size_t *written);
+enum squirrel_error keymap_save_ctx(struct squirrel_ctx *ctx, void *buffer,
+                                    size_t size, size_t *written);
+
+#endif
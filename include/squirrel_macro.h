@@ -0,0 +1,101 @@
+// SQUIRREL_MACRO_H provides macros: keys that type a sequence of keystrokes.
+//
+// A macro is a byte string of instructions, which can be a static const array
+// in flash. Playback never blocks: pressing a macro key queues the macro, and
+// the integration calls macro_step once per USB frame, between scans. Each call
+// makes at most one change to the keyboard report, so the host sees every
+// keystroke, and scanning goes on while a macro plays. Queued macros play one
+// after the other, from a fixed size queue in the context.
+#ifndef SQUIRREL_MACRO_H
+#define SQUIRREL_MACRO_H
+
+#include "squirrel.h"
+#include "squirrel_key.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// SQUIRREL_MACRO_QUEUE_SIZE is the number of macros that can be queued at
+// once, including the one playing.
+#ifndef SQUIRREL_MACRO_QUEUE_SIZE
+#define SQUIRREL_MACRO_QUEUE_SIZE 4
+#endif
+
+// macro_instruction is the first byte of each instruction of a macro. The
+// bytes after it are listed with each instruction.
+enum macro_instruction {
+  MACRO_END = 0,          // ends the macro
+  MACRO_PRESS,            // keycode: presses the keycode
+  MACRO_RELEASE,          // keycode: releases the keycode
+  MACRO_TAP,              // keycode: presses, then releases the keycode
+  MACRO_MODIFIER_PRESS,   // modifier: presses the modifiers
+  MACRO_MODIFIER_RELEASE, // modifier: releases the modifiers
+  MACRO_DELAY,            // low byte, high byte: waits that many frames
+  MACRO_TEXT, // ASCII characters, then 0: types the text on a US layout.
+              // Characters it cannot type are skipped.
+};
+
+// The MACRO_ macros below write instructions, for example:
+//   static const uint8_t hello[] = {MACRO_TEXT_START 'h', 'i',
+//                                   MACRO_TEXT_END MACRO_TAP_KEY(0x28)
+//                                   MACRO_END};
+#define MACRO_PRESS_KEY(keycode) MACRO_PRESS, (keycode),
+#define MACRO_RELEASE_KEY(keycode) MACRO_RELEASE, (keycode),
+#define MACRO_TAP_KEY(keycode) MACRO_TAP, (keycode),
+#define MACRO_PRESS_MODIFIER(modifier) MACRO_MODIFIER_PRESS, (modifier),
+#define MACRO_RELEASE_MODIFIER(modifier) MACRO_MODIFIER_RELEASE, (modifier),
+#define MACRO_WAIT(frames) MACRO_DELAY, (frames) & 0xFF, (frames) >> 8,
+#define MACRO_TEXT_START MACRO_TEXT,
+#define MACRO_TEXT_END 0,
+
+struct macro_playback {
+  uint8_t macro;     // the index of the macro in the table
+  uint16_t position; // the offset of the next instruction
+};
+
+// macro_state holds the macro table of a context, and the queue of macros
+// waiting to play. The first queued macro is the one playing.
+struct macro_state {
+  const uint8_t *const *macros;
+  uint8_t count;
+  struct macro_playback queue[SQUIRREL_MACRO_QUEUE_SIZE];
+  uint8_t head;
+  uint8_t queued;
+  uint16_t wait; // frames left of a MACRO_DELAY
+  uint8_t step;  // how far the current MACRO_TAP or character has got
+  bool text;     // true while typing the characters of a MACRO_TEXT
+  bool shifted;  // true if the current character pressed shift
+};
+
+// macro_set_table replaces the macros with count macros, which are not copied
+// and must outlive their use. It returns ERR_MACRO_PLAYING, and keeps the
+// table, while a macro is queued: a macro can be partway through a keystroke,
+// and forgetting it would leave the keycode or shift it pressed stuck.
+enum squirrel_error macro_set_table(const uint8_t *const *macros,
+                                    uint8_t count);
+enum squirrel_error macro_set_table_ctx(struct squirrel_ctx *ctx,
+                                        const uint8_t *const *macros,
+                                        uint8_t count);
+
+// macro_play queues the macro at the index. It returns ERR_MACRO_INVALID if
+// there is no such macro, or ERR_MACRO_QUEUE_FULL if
+// SQUIRREL_MACRO_QUEUE_SIZE macros are already queued.
+enum squirrel_error macro_play(uint8_t macro);
+enum squirrel_error macro_play_ctx(struct squirrel_ctx *ctx, uint8_t macro);
+
+// macro_playing returns true while a macro is queued.
+bool macro_playing(void);
+bool macro_playing_ctx(struct squirrel_ctx *ctx);
+
+// macro_step plays the queued macros up to their next change to the keyboard
+// report, and makes it. It should be called once per USB frame, after the
+// previous report was sent. It returns ERR_MACRO_INVALID, and drops the
+// macro, on an unknown instruction.
+enum squirrel_error macro_step(void);
+enum squirrel_error macro_step_ctx(struct squirrel_ctx *ctx);
+
+// macro_press queues the macro whose index is the argument. Releasing a macro
+// key does nothing, so the macro plays to its end.
+enum squirrel_error macro_press(struct squirrel_ctx *ctx, uint8_t layer,
+                                squirrel_key_index_t key_index, uint16_t arg);
+
+#endif
@@ -7,85 +7,334 @@
 #include <stdarg.h>
 #include <stdint.h>
 
+// SQUIRREL_LAYER_COUNT is the number of layers, up to 64.
+#ifndef SQUIRREL_LAYER_COUNT
+#define SQUIRREL_LAYER_COUNT 16
+#endif
+
+// squirrel_layer_mask_t is a bitmask with a bit per layer, only as wide as
+// SQUIRREL_LAYER_COUNT needs.
+#if SQUIRREL_LAYER_COUNT > 64
+#error "SQUIRREL_LAYER_COUNT must be at most 64"
+#elif SQUIRREL_LAYER_COUNT > 32
+typedef uint64_t squirrel_layer_mask_t;
+#elif SQUIRREL_LAYER_COUNT > 16
+typedef uint32_t squirrel_layer_mask_t;
+#elif SQUIRREL_LAYER_COUNT > 8
+typedef uint16_t squirrel_layer_mask_t;
+#else
+typedef uint8_t squirrel_layer_mask_t;
+#endif
+
+// LAYER_BIT returns the bit of the layer in a squirrel_layer_mask_t.
+#define LAYER_BIT(layer) ((squirrel_layer_mask_t)1 << (layer))
+// LAYER_MASK_ALL has the bit of every layer set.
+#define LAYER_MASK_ALL                                                         \
+  ((squirrel_layer_mask_t)(((uint64_t)2 << (SQUIRREL_LAYER_COUNT - 1)) - 1))
+
 struct layer {
-  bool active; // true if this layer is currently active
-  struct key keys[SQUIRREL_KEYCOUNT];
+  bool active; // true if this layer is currently active. A read-only view of
+               // active_layers, change it with layer_set_active.
+  const struct key *keys; // the base keymap of SQUIRREL_KEYCOUNT keys, which
+                          // can be a static const table in flash. NULL if
+                          // every key passes through. Read keys with
+                          // layer_get_key, which also sees runtime edits.
+  const uint32_t *present; // NULL for a dense layer. For a sparse layer, a
+                           // bitmap laid out like key_states of the keys that
+                           // do not pass through, and keys holds only those
+                           // keys, in index order.
+};
+
+// hold_key records that the key at the index was pressed on the layer.
+void hold_key(struct squirrel_ctx *ctx, uint8_t layer,
+              squirrel_key_index_t key_index);
+// release_held_keys releases the keys held on any of the layers, as they were
+// pressed, before the keys of those layers change. They stay held, so that
+// their own releases do nothing.
+void release_held_keys(struct squirrel_ctx *ctx, squirrel_layer_mask_t layers);
+
+// SQUIRREL_KEYMAP_OVERLAY_CAPACITY is the number of keys that can be edited
+// at runtime with layer_set_key, across all layers, on top of the base
+// keymaps. Each slot holds the key along with its layer and index.
+#ifndef SQUIRREL_KEYMAP_OVERLAY_CAPACITY
+#define SQUIRREL_KEYMAP_OVERLAY_CAPACITY 32
+#endif
+
+struct keymap_overlay_entry {
+  uint8_t layer;
+  squirrel_key_index_t key_index;
+  struct key key;
+};
+
+// keymap_overlay holds the keys edited with layer_set_key, sorted by layer and
+// then key index. present has a bit set for each edited key of each layer, so
+// that unedited keys never have to search the entries.
+struct keymap_overlay {
+  struct keymap_overlay_entry entries[SQUIRREL_KEYMAP_OVERLAY_CAPACITY];
+  uint16_t count;
+  uint32_t present[SQUIRREL_LAYER_COUNT][SQUIRREL_KEYSTATE_WORDS];
+};
+
+// actions holds the functions behind each built-in key_action.
+extern const struct action actions[ACTION_BUILTIN_COUNT];
+
+// layer_set_active activates or deactivates the layer with the given index.
+void layer_set_active(uint8_t layer, bool active);
+void layer_set_active_ctx(struct squirrel_ctx *ctx, uint8_t layer, bool active);
+
+// layer_set_active_mask replaces active_layers with the given bitmask. Bits
+// past the last layer are ignored.
+void layer_set_active_mask(squirrel_layer_mask_t mask);
+void layer_set_active_mask_ctx(struct squirrel_ctx *ctx,
+                               squirrel_layer_mask_t mask);
+
+// LAYER_NONE is returned by resolve_layer when no layer is active.
+#define LAYER_NONE 0xFF
+
+// resolve_layer returns the layer that a press of the key at the index
+// currently resolves to: the highest active layer that does not pass through,
+// or the lowest active layer if they all do. Results are cached per key until
+// the active layers or a key on an active layer change.
+uint8_t resolve_layer(squirrel_key_index_t key_index);
+uint8_t resolve_layer_ctx(struct squirrel_ctx *ctx,
+                          squirrel_key_index_t key_index);
+
+// layer_set_keymap sets the base keymap of a layer to keys, which must hold
+// SQUIRREL_KEYCOUNT keys and outlive its use. It is not copied. NULL makes
+// every key pass through. Runtime edits to the layer are forgotten.
+void layer_set_keymap(uint8_t layer, const struct key *keys);
+void layer_set_keymap_ctx(struct squirrel_ctx *ctx, uint8_t layer,
+                          const struct key *keys);
+
+// layer_set_sparse_keymap sets the base keymap of a layer to a sparse keymap,
+// for layers where most keys pass through. present is a bitmap of
+// SQUIRREL_KEYSTATE_WORDS words, laid out like key_states, with a bit set for
+// each key that does not pass through, and keys holds just those keys, in
+// index order. Neither is copied. Runtime edits to the layer are forgotten.
+void layer_set_sparse_keymap(uint8_t layer, const uint32_t *present,
+                             const struct key *keys);
+void layer_set_sparse_keymap_ctx(struct squirrel_ctx *ctx, uint8_t layer,
+                                 const uint32_t *present,
+                                 const struct key *keys);
+
+// layer_get_key returns the key at the index in a layer: the runtime edit if
+// there is one, otherwise the base keymap's key.
+struct key layer_get_key(uint8_t layer, squirrel_key_index_t key_index);
+struct key layer_get_key_ctx(struct squirrel_ctx *ctx, uint8_t layer,
+                             squirrel_key_index_t key_index);
+
+// layer_set_key replaces the key at the index in a layer, without touching the
+// base keymap. Edits are kept in a RAM overlay, and setting a key back to its
+// base keymap value frees its slot. It returns ERR_KEYMAP_OVERLAY_FULL if
+// SQUIRREL_KEYMAP_OVERLAY_CAPACITY keys are already edited.
+enum squirrel_error layer_set_key(uint8_t layer, squirrel_key_index_t key_index,
+                                  struct key key);
+enum squirrel_error layer_set_key_ctx(struct squirrel_ctx *ctx, uint8_t layer,
+                                      squirrel_key_index_t key_index,
+                                      struct key key);
+
+// layer_invalidate_cache forgets every cached resolve_layer result. It only
+// needs to be called after changing a base keymap in place.
+void layer_invalidate_cache(void);
+void layer_invalidate_cache_ctx(struct squirrel_ctx *ctx);
+
+// SQUIRREL_TAPPING_TERM is how long a tap-hold key has to be held, in
+// squirrel_tick time units, before it counts as held, unless changed with
+// tap_hold_set_mode.
+#ifndef SQUIRREL_TAPPING_TERM
+#define SQUIRREL_TAPPING_TERM 200
+#endif
+
+// SQUIRREL_TAP_HOLD_BUFFER_SIZE is the number of key events that are held back
+// while a tap-hold key is undecided. If more happen, the key counts as held.
+#ifndef SQUIRREL_TAP_HOLD_BUFFER_SIZE
+#define SQUIRREL_TAP_HOLD_BUFFER_SIZE 8
+#endif
+
+// tap_hold_mode selects what else, besides being held for the tapping term,
+// makes a tap-hold key count as held. Releasing it first always makes it a
+// tap.
+enum tap_hold_mode {
+  // TAP_HOLD_TIMEOUT only holds once the tapping term has passed (default).
+  TAP_HOLD_TIMEOUT = 0,
+  // TAP_HOLD_PERMISSIVE_HOLD also holds as soon as another key is pressed and
+  // released while the tap-hold key is down.
+  TAP_HOLD_PERMISSIVE_HOLD,
+  // TAP_HOLD_ON_OTHER_KEY_PRESS also holds as soon as another key is pressed
+  // while the tap-hold key is down.
+  TAP_HOLD_ON_OTHER_KEY_PRESS,
 };
 
-// layers is a list of all the layers in the keyboard. 0-15 are configured,
-// layer 16 is used for held keys and should only be modified by SQUIRREL.
-extern struct layer layers[17];
+// tap_hold_event is a key event held back behind an undecided tap-hold key.
+// An event whose key is already known, like a combo's, has resolved set and
+// dispatches key instead of looking up the key at key_index.
+struct tap_hold_event {
+  squirrel_key_index_t key_index;
+  bool pressed;
+  bool resolved;
+  struct key key;
+};
+
+// tap_hold_state holds the tap-hold settings of a context, and the tap-hold
+// key that is waiting to be decided. Key events that happen meanwhile are held
+// back in buffer, and replayed once it is decided.
+struct tap_hold_state {
+  enum tap_hold_mode mode;
+  uint16_t term; // 0 means SQUIRREL_TAPPING_TERM
+  bool pending;  // true while key_index is undecided
+  squirrel_key_index_t key_index;
+  struct key key;
+  uint8_t timer;
+  uint8_t buffered;
+  struct tap_hold_event buffer[SQUIRREL_TAP_HOLD_BUFFER_SIZE];
+  // tapped is a bitmap, laid out like key_states, of the tap-hold keys that
+  // were decided as taps and are still down.
+  uint32_t tapped[SQUIRREL_KEYSTATE_WORDS];
+};
+
+// tap_hold_set_mode selects how tap-hold keys are told apart, and the tapping
+// term, in squirrel_tick time units. A term of 0 uses SQUIRREL_TAPPING_TERM.
+void tap_hold_set_mode(enum tap_hold_mode mode, uint16_t term);
+void tap_hold_set_mode_ctx(struct squirrel_ctx *ctx, enum tap_hold_mode mode,
+                           uint16_t term);
+
+// tap_hold_intercept is called by key_event_stage while a tap-hold key is
+// undecided. It holds the event back, setting buffered, unless the event
+// decides the key. Deciding the key replays the held back events.
+enum squirrel_error tap_hold_intercept(struct squirrel_ctx *ctx,
+                                       squirrel_key_index_t key_index,
+                                       bool pressed, bool *buffered);
+
+// tap_hold_dispatch presses or releases key for the key at the index, like
+// dispatch_press_ctx and dispatch_release_ctx on layer 0, but after the
+// tap-hold stage: while a tap-hold key is undecided, the event is held back,
+// or decides it, like any other key event.
+enum squirrel_error tap_hold_dispatch(struct squirrel_ctx *ctx, struct key key,
+                                      squirrel_key_index_t key_index,
+                                      bool pressed);
 
 // key_nop does nothing (no operation)
-enum squirrel_error key_nop(uint8_t layer, uint8_t key_index, void *arg);
+enum squirrel_error key_nop(struct squirrel_ctx *ctx, uint8_t layer,
+                            squirrel_key_index_t key_index, uint16_t arg);
 
 // keyboard_press expects a single uint8 keycode
-enum squirrel_error keyboard_press(uint8_t layer, uint8_t key_index, void *arg);
+enum squirrel_error keyboard_press(struct squirrel_ctx *ctx, uint8_t layer,
+                                   squirrel_key_index_t key_index,
+                                   uint16_t arg);
 
 // keyboard_release expects a single uint8 keycode
-enum squirrel_error keyboard_release(uint8_t layer, uint8_t key_index,
-                                     void *arg);
+enum squirrel_error keyboard_release(struct squirrel_ctx *ctx, uint8_t layer,
+                                     squirrel_key_index_t key_index,
+                                     uint16_t arg);
 
 // keyboard_modifier_press expects a single uint8 modifier
-enum squirrel_error keyboard_modifier_press(uint8_t layer, uint8_t key_index,
-                                            void *arg);
+enum squirrel_error keyboard_modifier_press(struct squirrel_ctx *ctx,
+                                            uint8_t layer,
+                                            squirrel_key_index_t key_index,
+                                            uint16_t arg);
 
 // keyboard_modifier_release expects a single uint8 modifier
-enum squirrel_error keyboard_modifier_release(uint8_t layer, uint8_t key_index,
-                                              void *arg);
+enum squirrel_error keyboard_modifier_release(struct squirrel_ctx *ctx,
+                                              uint8_t layer,
+                                              squirrel_key_index_t key_index,
+                                              uint16_t arg);
 
 // consumer_press expects a single uint16 consumer code. See
 // https://www.freebsddiary.org/APC/usb_hid_usages for all defined codes.
-enum squirrel_error consumer_press(uint8_t layer, uint8_t key_index, void *arg);
+enum squirrel_error consumer_press(struct squirrel_ctx *ctx, uint8_t layer,
+                                   squirrel_key_index_t key_index,
+                                   uint16_t arg);
 
 // consumer_release expects a single uint16 consumer code. See
 // https://www.freebsddiary.org/APC/usb_hid_usages for all defined codes.
-enum squirrel_error consumer_release(uint8_t layer, uint8_t key_index,
-                                     void *arg);
+enum squirrel_error consumer_release(struct squirrel_ctx *ctx, uint8_t layer,
+                                     squirrel_key_index_t key_index,
+                                     uint16_t arg);
 
 // quantum_passthrough_press passes the press action to the highest active layer
 // below the current one. It expectes no extra args. Equivalent to KC_TRNS in
 // QMK.
-enum squirrel_error quantum_passthrough_press(uint8_t layer, uint8_t key_index,
-                                              void *arg);
+enum squirrel_error quantum_passthrough_press(struct squirrel_ctx *ctx,
+                                              uint8_t layer,
+                                              squirrel_key_index_t key_index,
+                                              uint16_t arg);
 
 // quantum_passthrough_release passes the release action to the highest active
 // layer below the current one. It expectes no extra args. Equivalent to KC_TRNS
 // in QMK.
-enum squirrel_error quantum_passthrough_release(uint8_t layer,
-                                                uint8_t key_index, void *arg);
+enum squirrel_error quantum_passthrough_release(struct squirrel_ctx *ctx,
+                                                uint8_t layer,
+                                                squirrel_key_index_t key_index,
+                                                uint16_t arg);
 
 // layer_momentary_press activates the layer with the given index. It expects
 // the layer number as the first uint8 argument. Equivalent to MO() in QMK.
-enum squirrel_error layer_momentary_press(uint8_t layer, uint8_t key_index,
-                                          void *arg);
+enum squirrel_error layer_momentary_press(struct squirrel_ctx *ctx,
+                                          uint8_t layer,
+                                          squirrel_key_index_t key_index,
+                                          uint16_t arg);
 
 // layer_momentary_release deactivates the layer with the given index. It
 // expects the layer number as the first uint8 argument. Equivalent to MO() in
 // QMK.
-enum squirrel_error layer_momentary_release(uint8_t layer, uint8_t key_index,
-                                            void *arg);
+enum squirrel_error layer_momentary_release(struct squirrel_ctx *ctx,
+                                            uint8_t layer,
+                                            squirrel_key_index_t key_index,
+                                            uint16_t arg);
 
 // layer_toggle_press toggles the layer with the given index. It expects the
 // layer number as the first uint8 argument. Equivalent to TG() in QMK.
-enum squirrel_error layer_toggle_press(uint8_t layer, uint8_t key_index,
-                                       void *arg);
+enum squirrel_error layer_toggle_press(struct squirrel_ctx *ctx, uint8_t layer,
+                                       squirrel_key_index_t key_index,
+                                       uint16_t arg);
 
 // layer_toggle_release does nothing at the moment. It expects the layer number
 // as a uint8 anyway - this is a placeholder for future functionality.
 // Equivalent to TG() in QMK.
-enum squirrel_error layer_toggle_release(uint8_t layer, uint8_t key_index,
-                                         void *arg);
+enum squirrel_error layer_toggle_release(struct squirrel_ctx *ctx,
+                                         uint8_t layer,
+                                         squirrel_key_index_t key_index,
+                                         uint16_t arg);
 
 // layer_solo_press turns off all other layers than the layer with the given
 // index. It expects the layer number as the first uint8 argument. Equivalent to
 // TO() in QMK.
-enum squirrel_error layer_solo_press(uint8_t layer, uint8_t key_index,
-                                     void *arg);
+enum squirrel_error layer_solo_press(struct squirrel_ctx *ctx, uint8_t layer,
+                                     squirrel_key_index_t key_index,
+                                     uint16_t arg);
 
 // layer_solo_release does nothing at the moment. It expects the layer number
 // as a uint8 anyway - this is a placeholder for future functionality.
 // Equivalent to TO() in QMK.
-enum squirrel_error layer_solo_release(uint8_t layer, uint8_t key_index,
-                                       void *arg);
+enum squirrel_error layer_solo_release(struct squirrel_ctx *ctx, uint8_t layer,
+                                       squirrel_key_index_t key_index,
+                                       uint16_t arg);
+
+// mod_tap_press starts deciding between a tap and a hold. It expects the
+// modifier in the high byte of the argument, and the keycode to tap in the low
+// byte. Equivalent to MT() in QMK.
+enum squirrel_error mod_tap_press(struct squirrel_ctx *ctx, uint8_t layer,
+                                  squirrel_key_index_t key_index, uint16_t arg);
+
+// mod_tap_release releases the keycode or the modifier, whichever the key was
+// decided as. A tapped keycode is pressed by the release itself, so it is only
+// released on the next squirrel_tick, for the host to see it. Equivalent to
+// MT() in QMK.
+enum squirrel_error mod_tap_release(struct squirrel_ctx *ctx, uint8_t layer,
+                                    squirrel_key_index_t key_index,
+                                    uint16_t arg);
+
+// layer_tap_press starts deciding between a tap and a hold. It expects the
+// layer in the high byte of the argument, and the keycode to tap in the low
+// byte. Equivalent to LT() in QMK.
+enum squirrel_error layer_tap_press(struct squirrel_ctx *ctx, uint8_t layer,
+                                    squirrel_key_index_t key_index,
+                                    uint16_t arg);
+
+// layer_tap_release releases the keycode or deactivates the layer, whichever
+// the key was decided as. A tapped keycode is released on the next
+// squirrel_tick, as with mod_tap_release. Equivalent to LT() in QMK.
+enum squirrel_error layer_tap_release(struct squirrel_ctx *ctx, uint8_t layer,
+                                      squirrel_key_index_t key_index,
+                                      uint16_t arg);
 #endif
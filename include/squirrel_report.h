@@ -0,0 +1,127 @@
+// SQUIRREL_REPORT_H provides change tracking for the HID reports, so an
+// integration only has to build and send a report when its state changed.
+#ifndef SQUIRREL_REPORT_H
+#define SQUIRREL_REPORT_H
+
+#include "squirrel.h"
+#include "squirrel_keyboard.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// report_type identifies a piece of HID report state.
+enum report_type {
+  REPORT_KEYBOARD = 0, // keyboard keycodes
+  REPORT_MODIFIERS,    // keyboard modifiers
+  REPORT_CONSUMER,     // consumer code
+  REPORT_TYPE_COUNT,
+};
+
+// REPORT_CHANGED returns the bit squirrel_report_changed uses for a type.
+#define REPORT_CHANGED(type) (1u << (type))
+
+// squirrel_report_mark_changed records that the state of the provided report
+// type changed. It is called through squirrel_report_transition by the
+// keyboard and consumer modules, only when their state actually changes.
+void squirrel_report_mark_changed(enum report_type type);
+void squirrel_report_mark_changed_ctx(struct squirrel_ctx *ctx,
+                                      enum report_type type);
+// squirrel_report_transition marks the report type as changed, like
+// squirrel_report_mark_changed, and records the change for
+// squirrel_report_frame if frames are enabled. code is the keycode, the
+// modifier bits, or the new consumer code, and pressed tells whether keycodes
+// and modifiers were pressed or released.
+void squirrel_report_transition(enum report_type type, uint16_t code,
+                                bool pressed);
+void squirrel_report_transition_ctx(struct squirrel_ctx *ctx,
+                                    enum report_type type, uint16_t code,
+                                    bool pressed);
+// squirrel_report_generation returns how many times the provided report type
+// has changed. It wraps around on overflow.
+uint32_t squirrel_report_generation(enum report_type type);
+uint32_t squirrel_report_generation_ctx(struct squirrel_ctx *ctx,
+                                        enum report_type type);
+// squirrel_report_changed returns a bitfield of REPORT_CHANGED bits for the
+// report types that changed since the last call, and clears it. If it returns
+// 0, nothing has to be sent.
+uint8_t squirrel_report_changed(void);
+uint8_t squirrel_report_changed_ctx(struct squirrel_ctx *ctx);
+
+// squirrel_report_snapshot is a copy of all HID report state at one moment.
+struct squirrel_report_snapshot {
+  struct keyboard_nkro_report keyboard;
+  uint16_t consumer_code;
+};
+
+// SQUIRREL_REPORT_QUEUE_SIZE is the number of changes that can wait for
+// squirrel_report_frame. It must be at most 255.
+#ifndef SQUIRREL_REPORT_QUEUE_SIZE
+#define SQUIRREL_REPORT_QUEUE_SIZE 32
+#endif
+
+struct report_transition {
+  uint8_t type; // a report_type
+  bool pressed;
+  uint16_t code;
+};
+
+// report_frames holds the changes that have not been sent yet, oldest first,
+// and sent, the state the host last received.
+struct report_frames {
+  bool enabled;
+  bool overflowed; // true if changes were lost, and sent must be resynced
+  uint8_t head;
+  uint8_t queued;
+  struct report_transition queue[SQUIRREL_REPORT_QUEUE_SIZE];
+  struct squirrel_report_snapshot sent;
+};
+
+// report_state holds the change tracking and published snapshots of a context.
+// snapshots is double buffered: snapshot n lives in snapshots[n % 2], and
+// sequence is the number of the latest published snapshot. The writer only
+// ever fills the buffer that is not the latest one, so readers keep copying the
+// latest snapshot while the next one is written, and only retry once it has
+// been published.
+struct report_state {
+  uint32_t generations[REPORT_TYPE_COUNT];
+  uint8_t changed;
+  struct squirrel_report_snapshot snapshots[2];
+  atomic_uint_fast32_t sequence;
+  struct report_frames frames;
+};
+
+// squirrel_report_publish copies keyboard_report and consumer_code into the
+// snapshot buffer that is not being read, then makes it the latest snapshot.
+// It never waits for readers. It must only be called from the core that runs
+// SQUIRREL, typically whenever squirrel_report_changed returns nonzero.
+void squirrel_report_publish(void);
+void squirrel_report_publish_ctx(struct squirrel_ctx *ctx);
+// squirrel_report_read copies the latest published snapshot into snapshot,
+// and returns the number of snapshots published so far, so a reader can skip
+// snapshots it has already sent. It is safe to call from another core, and
+// retries only if a whole new snapshot was published while it was copying.
+uint32_t squirrel_report_read(struct squirrel_report_snapshot *snapshot);
+uint32_t squirrel_report_read_ctx(struct squirrel_ctx *ctx,
+                                  struct squirrel_report_snapshot *snapshot);
+
+// squirrel_report_frame_enable starts or stops recording changes for
+// squirrel_report_frame. Changes made while it is stopped are not recorded.
+void squirrel_report_frame_enable(bool enabled);
+void squirrel_report_frame_enable_ctx(struct squirrel_ctx *ctx, bool enabled);
+// squirrel_report_frame plans the report for the next USB frame, and copies it
+// into report. It should be called once per frame, and its report sent if it
+// returns true. The recorded changes are applied in order, and as many as
+// possible are merged into one report, but a key or modifier that already
+// changed in this report ends it, so a press and release of the same key
+// between two frames are sent in two reports and the host sees the tap. A
+// modifier change after a keycode press, or a keycode release after a modifier
+// change, ends it too, as the host would apply the new modifiers to that key.
+// The rest wait for the next frame.
+//
+// If frames are not enabled, or more than SQUIRREL_REPORT_QUEUE_SIZE changes
+// were waiting, the report is the current state instead.
+bool squirrel_report_frame(struct squirrel_report_snapshot *report);
+bool squirrel_report_frame_ctx(struct squirrel_ctx *ctx,
+                               struct squirrel_report_snapshot *report);
+
+#endif
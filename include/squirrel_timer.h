@@ -0,0 +1,87 @@
+// SQUIRREL_TIMER_H provides timers, for actions that depend on time as well as
+// on presses and releases. SQUIRREL never reads a clock itself: the
+// integration passes the current time to squirrel_tick, in any unit (usually
+// milliseconds), so tests can drive time with a fake clock.
+//
+// Timers are kept in a hierarchical timer wheel: TIMER_LEVELS levels of
+// TIMER_SLOTS slots, where level n has slots TIMER_SLOTS^n ticks wide. Starting
+// or cancelling a timer is O(1), and each tick only looks at one slot per
+// level, however many timers are pending.
+#ifndef SQUIRREL_TIMER_H
+#define SQUIRREL_TIMER_H
+
+#include "squirrel.h"
+#include <stdint.h>
+
+// SQUIRREL_TIMER_CAPACITY is the number of timers that can be pending at once
+// in each context. It must be at most 254.
+#ifndef SQUIRREL_TIMER_CAPACITY
+#define SQUIRREL_TIMER_CAPACITY 8
+#endif
+
+#define TIMER_SLOT_BITS 4
+#define TIMER_SLOTS (1 << TIMER_SLOT_BITS)
+#define TIMER_LEVELS 3
+
+// TIMER_MAX_DELAY is the longest delay a timer can have, in ticks. Longer
+// delays are shortened to it.
+#define TIMER_MAX_DELAY ((1u << (TIMER_SLOT_BITS * TIMER_LEVELS)) - 1)
+
+// TIMER_NONE is returned by timer_start when every timer is in use.
+#define TIMER_NONE 0
+
+// TIMER_EXPIRING is the slot of a timer that expires on the current tick, and
+// waits in the expiring list for its function to be called.
+#define TIMER_EXPIRING 0xFF
+
+// timer_func is called when a timer expires, with the argument it was started
+// with.
+typedef enum squirrel_error (*timer_func)(struct squirrel_ctx *, uint16_t);
+
+struct timer {
+  uint32_t deadline;
+  timer_func func;
+  uint16_t arg;
+  uint8_t slot;     // the slot the timer is in, as level * TIMER_SLOTS + slot,
+                    // or TIMER_EXPIRING
+  uint8_t previous; // the timers of a slot form a doubly linked list
+  uint8_t next;
+};
+
+// timer_wheel holds the timers of a context. Timers are numbered from 1, so
+// that 0 can mean no timer and a zeroed wheel is empty.
+struct timer_wheel {
+  uint32_t now;                             // the time of the last tick
+  uint8_t slots[TIMER_LEVELS][TIMER_SLOTS]; // the first timer in each slot
+  uint8_t expiring; // the first timer expiring on the current tick
+  uint8_t pending;                          // the number of pending timers
+  uint8_t free;                             // the first unused timer
+  uint8_t used;                             // timers ever handed out
+  struct timer timers[SQUIRREL_TIMER_CAPACITY];
+};
+
+// timer_start calls func with arg once delay ticks have passed, and returns
+// the timer, or TIMER_NONE if SQUIRREL_TIMER_CAPACITY timers are already
+// pending. A delay of 0 is treated as 1.
+uint8_t timer_start(uint16_t delay, timer_func func, uint16_t arg);
+uint8_t timer_start_ctx(struct squirrel_ctx *ctx, uint16_t delay,
+                        timer_func func, uint16_t arg);
+
+// timer_cancel stops a pending timer, including one that expires on the tick
+// being run whose function has not been called yet. It must not be called with
+// a timer that already expired or was cancelled. TIMER_NONE is ignored.
+void timer_cancel(uint8_t timer);
+void timer_cancel_ctx(struct squirrel_ctx *ctx, uint8_t timer);
+
+// squirrel_now returns the time of the last tick.
+uint32_t squirrel_now(void);
+uint32_t squirrel_now_ctx(struct squirrel_ctx *ctx);
+
+// squirrel_tick advances time to now one tick at a time, calling the functions
+// of the timers that expire on each tick. It should be called at least once per
+// tick, typically once per scan. If a timer function returns an error, the
+// remaining timers still run, and the first error is returned.
+enum squirrel_error squirrel_tick(uint32_t now);
+enum squirrel_error squirrel_tick_ctx(struct squirrel_ctx *ctx, uint32_t now);
+
+#endif
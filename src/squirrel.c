@@ -1,6 +1,15 @@
 #include "squirrel.h"
+#include "squirrel_combo.h"
 #include "squirrel_consumer.h"
+#include "squirrel_ctx.h"
+#include "squirrel_debounce.h"
+#include "squirrel_event.h"
 #include "squirrel_init.h"
+#include "squirrel_instrument.h"
 #include "squirrel_key.h"
 #include "squirrel_keyboard.h"
+#include "squirrel_keymap_format.h"
+#include "squirrel_macro.h"
 #include "squirrel_quantum.h"
+#include "squirrel_report.h"
+#include "squirrel_timer.h"
@@ -0,0 +1,325 @@
+#include "squirrel_combo.h"
+#include "squirrel.h"
+#include "squirrel_ctx.h"
+#include "squirrel_key.h"
+#include "squirrel_quantum.h"
+#include "squirrel_timer.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#if SQUIRREL_COMBO_BUFFER_SIZE > 255
+#error "SQUIRREL_COMBO_BUFFER_SIZE must be at most 255"
+#endif
+
+// COMBO_NONE is returned by find_complete when no combo matches.
+#define COMBO_NONE UINT16_MAX
+
+void combo_add_key(struct combo *combo, squirrel_key_index_t key_index) {
+  combo->keys[key_index / 32] |= 1u << (key_index % 32);
+}
+
+// lowest_key returns the lowest key set in a bitmap laid out like key_states,
+// which must not be empty.
+static squirrel_key_index_t lowest_key(const uint32_t *keys) {
+  int w = 0;
+  while (keys[w] == 0) {
+    w++;
+  }
+  return w * 32 + __builtin_ctz(keys[w]);
+}
+
+// key_count returns the number of keys set in a bitmap laid out like
+// key_states.
+static uint16_t key_count(const uint32_t *keys) {
+  uint16_t count = 0;
+  for (int w = 0; w < SQUIRREL_KEYSTATE_WORDS; w++) {
+    count += __builtin_popcount(keys[w]);
+  }
+  return count;
+}
+
+// contains returns true if every key in subset is also in keys.
+static bool contains(const uint32_t *keys, const uint32_t *subset) {
+  for (int w = 0; w < SQUIRREL_KEYSTATE_WORDS; w++) {
+    if ((keys[w] & subset[w]) != subset[w]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool has_key(const uint32_t *keys, squirrel_key_index_t key_index) {
+  return (keys[key_index / 32] >> (key_index % 32)) & 1;
+}
+
+enum squirrel_error combo_set_table_ctx(struct squirrel_ctx *ctx,
+                                        const struct combo *combos,
+                                        uint16_t count) {
+  struct combo_state *cs = &ctx->combos;
+  timer_cancel_ctx(ctx, cs->timer);
+  uint16_t term = cs->term;
+  memset(cs, 0, sizeof(*cs));
+  cs->term = term;
+  if (count > SQUIRREL_COMBO_CAPACITY) {
+    return ERR_COMBO_TABLE_INVALID;
+  }
+  for (uint16_t i = 0; i < count; i++) {
+    uint16_t keys = key_count(combos[i].keys);
+    if (keys < 2 || keys > SQUIRREL_COMBO_BUFFER_SIZE) {
+      memset(cs->members, 0, sizeof(cs->members));
+      return ERR_COMBO_TABLE_INVALID;
+    }
+    for (int w = 0; w < SQUIRREL_KEYSTATE_WORDS; w++) {
+      cs->members[w] |= combos[i].keys[w];
+    }
+    // Insertion sort by lowest key. Combos with the same lowest key keep the
+    // order of the table.
+    squirrel_key_index_t lowest = lowest_key(combos[i].keys);
+    uint16_t j = i;
+    while (j > 0 && cs->lowest[j - 1] > lowest) {
+      cs->index[j] = cs->index[j - 1];
+      cs->lowest[j] = cs->lowest[j - 1];
+      j--;
+    }
+    cs->index[j] = i;
+    cs->lowest[j] = lowest;
+  }
+  for (uint16_t i = 0; i < count; i++) {
+    const uint32_t *keys = combos[cs->index[i]].keys;
+    for (int w = 0; w < SQUIRREL_KEYSTATE_WORDS; w++) {
+      for (uint32_t bits = keys[w]; bits != 0; bits &= bits - 1) {
+        int key_index = w * 32 + __builtin_ctz(bits);
+        cs->containing[key_index][i / 32] |= 1u << (i % 32);
+      }
+    }
+  }
+  cs->combos = combos;
+  cs->count = count;
+  return ERR_NONE;
+}
+enum squirrel_error combo_set_table(const struct combo *combos,
+                                    uint16_t count) {
+  return combo_set_table_ctx(&squirrel_default_ctx, combos, count);
+}
+
+void combo_set_term_ctx(struct squirrel_ctx *ctx, uint16_t term) {
+  ctx->combos.term = term;
+}
+void combo_set_term(uint16_t term) {
+  combo_set_term_ctx(&squirrel_default_ctx, term);
+}
+
+// first_with_lowest returns the position in the index of the first combo whose
+// lowest key is at least key_index.
+static uint16_t first_with_lowest(const struct combo_state *cs,
+                                  squirrel_key_index_t key_index) {
+  uint16_t low = 0;
+  uint16_t high = cs->count;
+  while (low < high) {
+    uint16_t middle = low + (high - low) / 2;
+    if (cs->lowest[middle] < key_index) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  return low;
+}
+
+// find_complete returns the combo made of exactly the pending keys, or
+// COMBO_NONE. If longer is not NULL, it is set if a longer combo with the same
+// lowest key could still complete.
+static uint16_t find_complete(const struct combo_state *cs, bool *longer) {
+  squirrel_key_index_t lowest = lowest_key(cs->pending);
+  uint16_t complete = COMBO_NONE;
+  for (uint16_t i = first_with_lowest(cs, lowest);
+       i < cs->count && cs->lowest[i] == lowest; i++) {
+    const uint32_t *keys = cs->combos[cs->index[i]].keys;
+    if (!contains(keys, cs->pending)) {
+      continue;
+    }
+    if (contains(cs->pending, keys)) {
+      complete = cs->index[i];
+    } else if (longer != NULL) {
+      *longer = true;
+    }
+  }
+  return complete;
+}
+
+// could_complete returns true if a combo with a lower lowest key than the
+// pending keys contains them all, so it could complete with more presses.
+// Those combos come before the pending keys' lowest key in the index, and are
+// intersected with the combos containing each pending key, 32 at a time.
+static bool could_complete(const struct combo_state *cs) {
+  uint16_t end = first_with_lowest(cs, lowest_key(cs->pending));
+  for (int w = 0; w * 32 < end; w++) {
+    uint32_t candidates = UINT32_MAX;
+    if (end - w * 32 < 32) {
+      candidates = (1u << (end % 32)) - 1; // only combos before end
+    }
+    for (uint8_t i = 0; i < cs->buffered && candidates != 0; i++) {
+      candidates &= cs->containing[cs->buffer[i]][w];
+    }
+    if (candidates != 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static enum squirrel_error combo_timeout(struct squirrel_ctx *ctx,
+                                         uint16_t arg);
+
+// restart_timer gives the held back presses a new combo term, from now.
+static void restart_timer(struct squirrel_ctx *ctx) {
+  struct combo_state *cs = &ctx->combos;
+  timer_cancel_ctx(ctx, cs->timer);
+  cs->timer = TIMER_NONE;
+  if (cs->buffered > 0) {
+    // Without a free timer, the presses are still let go by other keys.
+    uint16_t term = cs->term != 0 ? cs->term : SQUIRREL_COMBO_TERM;
+    cs->timer = timer_start_ctx(ctx, term, combo_timeout, 0);
+  }
+}
+
+// replay lets the first count held back presses go on, in order, as presses
+// that are not part of a combo.
+static enum squirrel_error replay(struct squirrel_ctx *ctx, uint8_t count) {
+  struct combo_state *cs = &ctx->combos;
+  squirrel_key_index_t keys[SQUIRREL_COMBO_BUFFER_SIZE];
+  memcpy(keys, cs->buffer, count * sizeof(keys[0]));
+  cs->buffered -= count;
+  memmove(cs->buffer, cs->buffer + count, cs->buffered * sizeof(keys[0]));
+  for (uint8_t i = 0; i < count; i++) {
+    cs->pending[keys[i] / 32] &= ~(1u << (keys[i] % 32));
+  }
+  restart_timer(ctx);
+  for (uint8_t i = 0; i < count; i++) {
+    enum squirrel_error err =
+        key_event_stage_ctx(ctx, keys[i], true, KEY_STAGE_TAP_HOLD);
+    if (err != ERR_NONE) {
+      return err;
+    }
+  }
+  return ERR_NONE;
+}
+
+// fire performs the combo made of the pending keys.
+static enum squirrel_error fire(struct squirrel_ctx *ctx, uint16_t combo) {
+  struct combo_state *cs = &ctx->combos;
+  if (cs->active_count == SQUIRREL_COMBO_ACTIVE) {
+    return replay(ctx, cs->buffered); // no room to remember it
+  }
+  for (int w = 0; w < SQUIRREL_KEYSTATE_WORDS; w++) {
+    cs->consumed[w] |= cs->pending[w];
+    cs->pending[w] = 0;
+  }
+  cs->buffered = 0;
+  restart_timer(ctx);
+  cs->active[cs->active_count++] = combo;
+  const struct combo *c = &cs->combos[combo];
+  // The combo comes before the tap-hold stage, so its press waits behind an
+  // undecided tap-hold key like the presses it stands for would have.
+  return tap_hold_dispatch(ctx, c->key, lowest_key(c->keys), true);
+}
+
+// resolve performs the combo made of the pending keys if there is one, and
+// otherwise lets them all go on.
+static enum squirrel_error resolve(struct squirrel_ctx *ctx) {
+  struct combo_state *cs = &ctx->combos;
+  uint16_t combo = find_complete(cs, NULL);
+  if (combo != COMBO_NONE) {
+    return fire(ctx, combo);
+  }
+  return replay(ctx, cs->buffered);
+}
+
+static enum squirrel_error combo_timeout(struct squirrel_ctx *ctx,
+                                         uint16_t arg) {
+  (void)arg;
+  ctx->combos.timer = TIMER_NONE; // it just expired
+  if (ctx->combos.buffered == 0) {
+    return ERR_NONE;
+  }
+  return resolve(ctx);
+}
+
+// match decides what the pending keys are, now that another was pressed.
+static enum squirrel_error match(struct squirrel_ctx *ctx) {
+  struct combo_state *cs = &ctx->combos;
+  bool longer = false;
+  uint16_t combo = find_complete(cs, &longer);
+  if (combo != COMBO_NONE && !longer) {
+    return fire(ctx, combo);
+  }
+  if (combo != COMBO_NONE || longer || could_complete(cs)) {
+    return ERR_NONE; // wait for more keys
+  }
+  // No combo has all the pending keys. The newest press may still start one,
+  // so only the presses before it go on.
+  return replay(ctx, cs->buffered - 1);
+}
+
+// release releases the active combos that contain the key at the index.
+static enum squirrel_error release(struct squirrel_ctx *ctx,
+                                   squirrel_key_index_t key_index) {
+  struct combo_state *cs = &ctx->combos;
+  cs->consumed[key_index / 32] &= ~(1u << (key_index % 32));
+  enum squirrel_error result = ERR_NONE;
+  uint8_t i = 0;
+  while (i < cs->active_count) {
+    const struct combo *c = &cs->combos[cs->active[i]];
+    if (!has_key(c->keys, key_index)) {
+      i++;
+      continue;
+    }
+    cs->active[i] = cs->active[--cs->active_count];
+    enum squirrel_error err =
+        tap_hold_dispatch(ctx, c->key, lowest_key(c->keys), false);
+    if (err != ERR_NONE && result == ERR_NONE) {
+      result = err;
+    }
+  }
+  return result;
+}
+
+enum squirrel_error combo_intercept(struct squirrel_ctx *ctx,
+                                    squirrel_key_index_t key_index,
+                                    bool pressed, bool *held_back) {
+  struct combo_state *cs = &ctx->combos;
+  *held_back = false;
+  enum squirrel_error err;
+  if (!pressed) {
+    if (has_key(cs->pending, key_index)) {
+      // Released before the combo completed, so the held back presses are
+      // decided first, and the release goes on after them.
+      err = resolve(ctx);
+      if (err != ERR_NONE) {
+        return err;
+      }
+    }
+    if (has_key(cs->consumed, key_index)) {
+      *held_back = true;
+      return release(ctx, key_index);
+    }
+    return ERR_NONE;
+  }
+  if (!has_key(cs->members, key_index)) {
+    return cs->buffered == 0 ? ERR_NONE : resolve(ctx);
+  }
+  if (cs->buffered == SQUIRREL_COMBO_BUFFER_SIZE) {
+    err = resolve(ctx); // no room to wait any longer
+    if (err != ERR_NONE) {
+      return err;
+    }
+  }
+  cs->pending[key_index / 32] |= 1u << (key_index % 32);
+  cs->buffer[cs->buffered++] = key_index;
+  *held_back = true;
+  if (cs->buffered == 1) {
+    restart_timer(ctx);
+  }
+  return match(ctx);
+}
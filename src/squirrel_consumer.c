@@ -1,12 +1,32 @@
 #include "squirrel_consumer.h"
+#include "squirrel_ctx.h"
+#include "squirrel_report.h"
 #include <stdint.h>
 
-uint16_t consumer_code = 0;
-
-void consumer_activate_consumer_code(uint16_t code) { consumer_code = code; }
-void consumer_deactivate_consumer_code(uint16_t code) {
-  if (consumer_code == code) {
-    consumer_code = 0;
+void consumer_activate_consumer_code_ctx(struct squirrel_ctx *ctx,
+                                         uint16_t code) {
+  if (ctx->consumer_code == code) {
+    return;
+  }
+  ctx->consumer_code = code;
+  squirrel_report_transition_ctx(ctx, REPORT_CONSUMER, code, code != 0);
+}
+void consumer_activate_consumer_code(uint16_t code) {
+  consumer_activate_consumer_code_ctx(&squirrel_default_ctx, code);
+}
+void consumer_deactivate_consumer_code_ctx(struct squirrel_ctx *ctx,
+                                           uint16_t code) {
+  if (ctx->consumer_code == code && code != 0) {
+    ctx->consumer_code = 0;
+    squirrel_report_transition_ctx(ctx, REPORT_CONSUMER, 0, false);
   }
 }
-uint16_t consumer_get_consumer_code() { return consumer_code; }
+void consumer_deactivate_consumer_code(uint16_t code) {
+  consumer_deactivate_consumer_code_ctx(&squirrel_default_ctx, code);
+}
+uint16_t consumer_get_consumer_code_ctx(struct squirrel_ctx *ctx) {
+  return ctx->consumer_code;
+}
+uint16_t consumer_get_consumer_code() {
+  return consumer_get_consumer_code_ctx(&squirrel_default_ctx);
+}
@@ -0,0 +1,96 @@
+#include "squirrel_debounce.h"
+#include "squirrel.h"
+#include "squirrel_ctx.h"
+#include "squirrel_key.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+void debounce_set_mode_ctx(struct squirrel_ctx *ctx, enum debounce_mode mode,
+                           uint8_t window) {
+  if (window > DEBOUNCE_MAX_WINDOW) {
+    window = DEBOUNCE_MAX_WINDOW;
+  }
+  struct debounce_state *state = &ctx->debounce;
+  state->mode = mode;
+  state->window = window;
+  memset(state->counters, 0, sizeof(state->counters));
+  memcpy(state->last_raw, ctx->key_states, sizeof(state->last_raw));
+  state->stable_scans = 0;
+}
+void debounce_set_mode(enum debounce_mode mode, uint8_t window) {
+  debounce_set_mode_ctx(&squirrel_default_ctx, mode, window);
+}
+
+// count increments the counters of the keys in counting and clears the rest,
+// then returns the keys whose counters reached the window, clearing them.
+static uint32_t count(struct debounce_state *state, int w, uint32_t counting) {
+  uint32_t(*counters)[SQUIRREL_KEYSTATE_WORDS] = state->counters;
+  uint32_t carry = counting;
+  for (int b = 0; b < DEBOUNCE_COUNTER_BITS; b++) {
+    counters[b][w] &= counting;
+    uint32_t next_carry = counters[b][w] & carry;
+    counters[b][w] ^= carry;
+    carry = next_carry;
+  }
+  uint32_t reached = counting;
+  for (int b = 0; b < DEBOUNCE_COUNTER_BITS; b++) {
+    reached &= ((state->window >> b) & 1) ? counters[b][w] : ~counters[b][w];
+  }
+  for (int b = 0; b < DEBOUNCE_COUNTER_BITS; b++) {
+    counters[b][w] &= ~reached;
+  }
+  return reached;
+}
+
+// same_scan returns true if two scans read the same for every key. Bits past
+// SQUIRREL_KEYCOUNT are ignored, as check_keys does.
+static bool same_scan(const uint32_t *a, const uint32_t *b) {
+  uint32_t differ = 0;
+  for (int i = 0; i < SQUIRREL_KEYSTATE_WORDS - 1; i++) {
+    differ |= a[i] ^ b[i];
+  }
+  int w = SQUIRREL_KEYSTATE_WORDS - 1;
+  uint32_t last = a[w] ^ b[w];
+  if (SQUIRREL_KEYCOUNT % 32 != 0) {
+    last &= (1u << (SQUIRREL_KEYCOUNT % 32)) - 1; // ignore unused bits
+  }
+  return (differ | last) == 0;
+}
+
+enum squirrel_error debounce_scan_ctx(struct squirrel_ctx *ctx,
+                                      const uint32_t *raw) {
+  struct debounce_state *state = &ctx->debounce;
+  if (state->mode == DEBOUNCE_NONE || state->window <= 1) {
+    return check_keys_ctx(ctx, raw);
+  }
+  if (state->mode == DEBOUNCE_SYM_DEFER) {
+    if (!same_scan(raw, state->last_raw)) {
+      memcpy(state->last_raw, raw, sizeof(state->last_raw));
+      state->stable_scans = 1;
+      return ERR_NONE;
+    }
+    if (state->stable_scans < state->window) {
+      state->stable_scans++;
+    }
+    if (state->stable_scans < state->window) {
+      return ERR_NONE;
+    }
+    return check_keys_ctx(ctx, raw);
+  }
+  const uint32_t *key_states = ctx->key_states;
+  uint32_t debounced[SQUIRREL_KEYSTATE_WORDS];
+  for (int w = 0; w < SQUIRREL_KEYSTATE_WORDS; w++) {
+    if (state->mode == DEBOUNCE_EAGER_DEFER_PK) {
+      uint32_t presses = raw[w] & ~key_states[w];
+      uint32_t releases = count(state, w, ~raw[w] & key_states[w]);
+      debounced[w] = (key_states[w] | presses) & ~releases;
+      continue;
+    }
+    debounced[w] = key_states[w] ^ count(state, w, raw[w] ^ key_states[w]);
+  }
+  return check_keys_ctx(ctx, debounced);
+}
+enum squirrel_error debounce_scan(const uint32_t *raw) {
+  return debounce_scan_ctx(&squirrel_default_ctx, raw);
+}
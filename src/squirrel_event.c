@@ -0,0 +1,83 @@
+#include "squirrel_event.h"
+#include "squirrel.h"
+#include "squirrel_ctx.h"
+#include "squirrel_key.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#if (SQUIRREL_EVENT_QUEUE_CAPACITY & (SQUIRREL_EVENT_QUEUE_CAPACITY - 1)) != 0
+#error "SQUIRREL_EVENT_QUEUE_CAPACITY must be a power of two"
+#endif
+
+bool squirrel_enqueue_event_ctx(struct squirrel_ctx *ctx,
+                                squirrel_key_index_t key_index, bool pressed,
+                                uint32_t timestamp) {
+  struct event_queue *queue = &ctx->events;
+  uint_fast32_t h = atomic_load_explicit(&queue->head, memory_order_relaxed);
+  uint_fast32_t t = atomic_load_explicit(&queue->tail, memory_order_acquire);
+  if ((uint32_t)(h - t) >= SQUIRREL_EVENT_QUEUE_CAPACITY) {
+    atomic_store_explicit(
+        &queue->overflows,
+        atomic_load_explicit(&queue->overflows, memory_order_relaxed) + 1,
+        memory_order_relaxed);
+    return false;
+  }
+  struct key_event *event =
+      &queue->events[h & (SQUIRREL_EVENT_QUEUE_CAPACITY - 1)];
+  event->timestamp = timestamp;
+  event->key_index = key_index;
+  event->pressed = pressed;
+  // Publish the event only after it has been written.
+  atomic_store_explicit(&queue->head, h + 1, memory_order_release);
+  return true;
+}
+bool squirrel_enqueue_event(squirrel_key_index_t key_index, bool pressed,
+                            uint32_t timestamp) {
+  return squirrel_enqueue_event_ctx(&squirrel_default_ctx, key_index, pressed,
+                                    timestamp);
+}
+
+enum squirrel_error squirrel_process_events_ctx(struct squirrel_ctx *ctx,
+                                                uint16_t max_events) {
+  struct event_queue *queue = &ctx->events;
+  uint_fast32_t t = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+  uint_fast32_t h = atomic_load_explicit(&queue->head, memory_order_acquire);
+  uint32_t available = h - t;
+  if (max_events != 0 && available > max_events) {
+    available = max_events;
+  }
+  enum squirrel_error err = ERR_NONE;
+  uint32_t processed = 0;
+  while (processed < available) {
+    struct key_event event =
+        queue->events[t & (SQUIRREL_EVENT_QUEUE_CAPACITY - 1)];
+    t++;
+    processed++;
+    queue->event_time = event.timestamp;
+    err = check_key_ctx(ctx, event.key_index, event.pressed);
+    if (err != ERR_NONE) {
+      break;
+    }
+  }
+  // Hand the whole batch of slots back to the producer at once.
+  atomic_store_explicit(&queue->tail, t, memory_order_release);
+  return err;
+}
+enum squirrel_error squirrel_process_events(uint16_t max_events) {
+  return squirrel_process_events_ctx(&squirrel_default_ctx, max_events);
+}
+
+uint32_t squirrel_event_time_ctx(struct squirrel_ctx *ctx) {
+  return ctx->events.event_time;
+}
+uint32_t squirrel_event_time(void) {
+  return squirrel_event_time_ctx(&squirrel_default_ctx);
+}
+
+uint32_t squirrel_event_overflows_ctx(struct squirrel_ctx *ctx) {
+  return atomic_load_explicit(&ctx->events.overflows, memory_order_relaxed);
+}
+uint32_t squirrel_event_overflows(void) {
+  return squirrel_event_overflows_ctx(&squirrel_default_ctx);
+}
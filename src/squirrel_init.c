@@ -1,23 +1,21 @@
 #include "squirrel_init.h"
 #include "squirrel.h"
-#include "squirrel_key.h"
-#include "squirrel_quantum.h"
+#include "squirrel_ctx.h"
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-enum squirrel_error squirrel_init(void) {
-  struct key passthrough_key = (struct key){
-      .pressed = quantum_passthrough_press,
-      .released = quantum_passthrough_release,
-  };
-  for (int j = 16; j >= 0; j--) {
-    layers[j].active = false;
-    for (int i = 0; i < SQUIRREL_KEYCOUNT; i++) {
-      copy_key(&passthrough_key, &layers[j].keys[i]);
-    }
-  }
-  layers[16].active = true;
+struct squirrel_ctx squirrel_default_ctx = {0};
+
+enum squirrel_error squirrel_init_ctx(struct squirrel_ctx *ctx) {
+  // Zeroed state is a keyboard with no keys held, no layers active and every
+  // layer without a base keymap or edits, so every key passes through.
+  // Nothing is copied per key.
+  memset(ctx, 0, sizeof(*ctx));
   return ERR_NONE;
+}
+
+enum squirrel_error squirrel_init(void) {
+  return squirrel_init_ctx(&squirrel_default_ctx);
 };
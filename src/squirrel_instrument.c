@@ -0,0 +1,74 @@
+#include "squirrel_instrument.h"
+
+#ifdef SQUIRREL_INSTRUMENTATION
+
+#include "squirrel_ctx.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+static instrument_clock clock_source = NULL;
+
+void instrument_set_clock(instrument_clock clock) { clock_source = clock; }
+
+void instrument_snapshot_ctx(struct squirrel_ctx *ctx,
+                             struct instrument_stats *snapshot) {
+  *snapshot = ctx->instrument;
+}
+void instrument_snapshot(struct instrument_stats *snapshot) {
+  instrument_snapshot_ctx(&squirrel_default_ctx, snapshot);
+}
+
+void instrument_reset_ctx(struct squirrel_ctx *ctx) {
+  memset(&ctx->instrument, 0, sizeof(ctx->instrument));
+}
+void instrument_reset(void) { instrument_reset_ctx(&squirrel_default_ctx); }
+
+uint32_t instrument_start(void) {
+  if (clock_source == NULL) {
+    return 0;
+  }
+  return clock_source();
+}
+
+static void record(struct instrument_timing *timing, uint32_t start) {
+  uint32_t duration = 0;
+  if (clock_source != NULL) {
+    duration = clock_source() - start; // unsigned, so wrapping is fine
+  }
+  if (timing->calls == 0 || duration < timing->min) {
+    timing->min = duration;
+  }
+  if (duration > timing->max) {
+    timing->max = duration;
+  }
+  timing->total += duration;
+  timing->calls++;
+}
+
+void instrument_stop(struct squirrel_ctx *ctx, enum instrument_point point,
+                     uint32_t start) {
+  record(&ctx->instrument.points[point], start);
+}
+
+void instrument_stop_dispatch(struct squirrel_ctx *ctx, uint16_t action,
+                              uint32_t start) {
+  uint32_t slot = action;
+  if (action >= ACTION_CUSTOM) {
+    slot = ACTION_BUILTIN_COUNT + (action - ACTION_CUSTOM);
+  } else if (action >= ACTION_BUILTIN_COUNT) {
+    return;
+  }
+  if (slot >= ACTION_BUILTIN_COUNT + SQUIRREL_CUSTOM_ACTION_COUNT) {
+    return;
+  }
+  record(&ctx->instrument.dispatches[slot], start);
+}
+
+void instrument_depth(struct squirrel_ctx *ctx, uint8_t depth) {
+  if (depth > ctx->instrument.max_passthrough_depth) {
+    ctx->instrument.max_passthrough_depth = depth;
+  }
+}
+
+#endif
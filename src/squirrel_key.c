@@ -1,67 +1,285 @@
 #include "squirrel_key.h"
 #include "squirrel.h"
+#include "squirrel_combo.h"
+#include "squirrel_consumer.h"
+#include "squirrel_ctx.h"
+#include "squirrel_instrument.h"
+#include "squirrel_keyboard.h"
 #include "squirrel_quantum.h"
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 
+struct action custom_actions[SQUIRREL_CUSTOM_ACTION_COUNT] = {};
+
 void copy_key(struct key *source, struct key *destination) {
   *destination = *source;
 }
 
-enum squirrel_error press_key(uint8_t key_index) {
-  for (int i = 16; i >= 0; i--) {
-    if (!layers[i].active) {
-      continue;
-    }
-    struct key selected_key = layers[i].keys[key_index];
-    enum squirrel_error err =
-        selected_key.pressed(i, key_index, selected_key.pressed_argument);
-    if (err != ERR_NONE) {
-      return err;
-    }
-    if (i == 16) {
-      break;
+// find_action returns the action used by the key, or NULL if there is none.
+static const struct action *find_action(struct key key) {
+  if (key.action < ACTION_BUILTIN_COUNT) {
+    return &actions[key.action];
+  }
+  if (key.action < ACTION_CUSTOM ||
+      key.action - ACTION_CUSTOM >= SQUIRREL_CUSTOM_ACTION_COUNT) {
+    return NULL;
+  }
+  return &custom_actions[key.action - ACTION_CUSTOM];
+}
+
+// call_pressed does the work of dispatch_press.
+static enum squirrel_error call_pressed(struct squirrel_ctx *ctx,
+                                        struct key key, uint8_t layer,
+                                        squirrel_key_index_t key_index) {
+#ifdef SQUIRREL_SWITCH_DISPATCH
+  // Handle the built-in actions without an indirect call.
+  switch (key.action) {
+  case ACTION_PASSTHROUGH:
+    return quantum_passthrough_press(ctx, layer, key_index, key.argument);
+  case ACTION_NOP:
+    return ERR_NONE;
+  case ACTION_KEYBOARD:
+    keyboard_activate_keycode_ctx(ctx, key.argument);
+    return ERR_NONE;
+  case ACTION_KEYBOARD_MODIFIER:
+    keyboard_activate_modifier_ctx(ctx, key.argument);
+    return ERR_NONE;
+  case ACTION_CONSUMER:
+    consumer_activate_consumer_code_ctx(ctx, key.argument);
+    return ERR_NONE;
+  case ACTION_LAYER_MOMENTARY:
+    layer_set_active_ctx(ctx, key.argument, true);
+    return ERR_NONE;
+  case ACTION_LAYER_TOGGLE:
+    layer_set_active_mask_ctx(ctx,
+                              ctx->active_layers ^ LAYER_BIT(key.argument));
+    return ERR_NONE;
+  case ACTION_LAYER_SOLO:
+    return layer_solo_press(ctx, layer, key_index, key.argument);
+  }
+#endif
+  const struct action *action = find_action(key);
+  if (action == NULL || action->pressed == NULL) {
+    return ERR_UNKNOWN_ACTION;
+  }
+  return action->pressed(ctx, layer, key_index, key.argument);
+}
+
+// call_released does the work of dispatch_release.
+static enum squirrel_error call_released(struct squirrel_ctx *ctx,
+                                         struct key key, uint8_t layer,
+                                         squirrel_key_index_t key_index) {
+#ifdef SQUIRREL_SWITCH_DISPATCH
+  // Handle the built-in actions without an indirect call.
+  switch (key.action) {
+  case ACTION_PASSTHROUGH:
+    return quantum_passthrough_release(ctx, layer, key_index, key.argument);
+  case ACTION_NOP:
+  case ACTION_LAYER_TOGGLE:
+  case ACTION_LAYER_SOLO:
+    return ERR_NONE;
+  case ACTION_KEYBOARD:
+    keyboard_deactivate_keycode_ctx(ctx, key.argument);
+    return ERR_NONE;
+  case ACTION_KEYBOARD_MODIFIER:
+    keyboard_deactivate_modifier_ctx(ctx, key.argument);
+    return ERR_NONE;
+  case ACTION_CONSUMER:
+    consumer_deactivate_consumer_code_ctx(ctx, key.argument);
+    return ERR_NONE;
+  case ACTION_LAYER_MOMENTARY:
+    layer_set_active_ctx(ctx, key.argument, false);
+    return ERR_NONE;
+  }
+#endif
+  const struct action *action = find_action(key);
+  if (action == NULL || action->released == NULL) {
+    return ERR_UNKNOWN_ACTION;
+  }
+  return action->released(ctx, layer, key_index, key.argument);
+}
+
+enum squirrel_error dispatch_press_ctx(struct squirrel_ctx *ctx, struct key key,
+                                       uint8_t layer,
+                                       squirrel_key_index_t key_index) {
+  SQUIRREL_INSTRUMENT_START(start);
+  enum squirrel_error err = call_pressed(ctx, key, layer, key_index);
+  SQUIRREL_INSTRUMENT_STOP_DISPATCH(ctx, key.action, start);
+  return err;
+}
+enum squirrel_error dispatch_press(struct key key, uint8_t layer,
+                                   squirrel_key_index_t key_index) {
+  return dispatch_press_ctx(&squirrel_default_ctx, key, layer, key_index);
+}
+
+enum squirrel_error dispatch_release_ctx(struct squirrel_ctx *ctx,
+                                         struct key key, uint8_t layer,
+                                         squirrel_key_index_t key_index) {
+  SQUIRREL_INSTRUMENT_START(start);
+  enum squirrel_error err = call_released(ctx, key, layer, key_index);
+  SQUIRREL_INSTRUMENT_STOP_DISPATCH(ctx, key.action, start);
+  return err;
+}
+enum squirrel_error dispatch_release(struct key key, uint8_t layer,
+                                     squirrel_key_index_t key_index) {
+  return dispatch_release_ctx(&squirrel_default_ctx, key, layer, key_index);
+}
+
+// is_held returns true if the key at the index was pressed and not released.
+static bool is_held(const struct squirrel_ctx *ctx,
+                    squirrel_key_index_t key_index) {
+  return (ctx->held_keys[key_index / 32] >> (key_index % 32)) & 1;
+}
+
+// find_and_press does the work of press_key.
+static enum squirrel_error find_and_press(struct squirrel_ctx *ctx,
+                                          squirrel_key_index_t key_index) {
+  if (is_held(ctx, key_index)) {
+    uint8_t layer = ctx->held_from_layer[key_index];
+    if (layer == LAYER_NONE) {
+      return ERR_NONE; // released early, as its key changed
     }
-    copy_key(&selected_key, &layers[16].keys[key_index]);
-    break;
+    return dispatch_press_ctx(ctx, layer_get_key_ctx(ctx, layer, key_index),
+                              layer, key_index);
+  }
+  uint8_t i = resolve_layer_ctx(ctx, key_index);
+  if (i == LAYER_NONE) {
+    return ERR_NONE;
+  }
+  struct key selected_key = layer_get_key_ctx(ctx, i, key_index);
+  enum squirrel_error err = dispatch_press_ctx(ctx, selected_key, i, key_index);
+  if (err != ERR_NONE) {
+    return err;
+  }
+  // A passthrough key records the layer it passed to itself.
+  if (selected_key.action != ACTION_PASSTHROUGH) {
+    hold_key(ctx, i, key_index);
   }
   return ERR_NONE;
 }
 
-enum squirrel_error release_key(uint8_t key_index) {
-  for (int i = 16; i >= 0; i--) {
-    if (!layers[i].active) {
-      continue;
+// find_and_release does the work of release_key.
+static enum squirrel_error find_and_release(struct squirrel_ctx *ctx,
+                                            squirrel_key_index_t key_index) {
+  if (is_held(ctx, key_index)) {
+    // A key whose key changed while it was held was already released.
+    uint8_t layer = ctx->held_from_layer[key_index];
+    if (layer != LAYER_NONE) {
+      enum squirrel_error err = dispatch_release_ctx(
+          ctx, layer_get_key_ctx(ctx, layer, key_index), layer, key_index);
+      if (err != ERR_NONE) {
+        return err;
+      }
     }
-    struct key selected_key = layers[i].keys[key_index];
-    enum squirrel_error err =
-        selected_key.released(i, key_index, selected_key.released_argument);
-    if (err != ERR_NONE) {
+    ctx->held_keys[key_index / 32] &= ~(1u << (key_index % 32));
+    return ERR_NONE;
+  }
+  uint8_t i = resolve_layer_ctx(ctx, key_index);
+  if (i == LAYER_NONE) {
+    return ERR_NONE;
+  }
+  return dispatch_release_ctx(ctx, layer_get_key_ctx(ctx, i, key_index), i,
+                              key_index);
+}
+
+enum squirrel_error key_event_stage_ctx(struct squirrel_ctx *ctx,
+                                        squirrel_key_index_t key_index,
+                                        bool pressed, enum key_stage stage) {
+  bool held_back = false;
+  enum squirrel_error err = ERR_NONE;
+  if (stage <= KEY_STAGE_COMBO && ctx->combos.count != 0) {
+    err = combo_intercept(ctx, key_index, pressed, &held_back);
+    if (err != ERR_NONE || held_back) {
       return err;
     }
-    if (i != 16) {
-      break;
+  }
+  if (stage <= KEY_STAGE_TAP_HOLD && ctx->tap_hold.pending) {
+    err = tap_hold_intercept(ctx, key_index, pressed, &held_back);
+    if (err != ERR_NONE || held_back) {
+      return err;
     }
-    struct key passthrough_key;
-    passthrough_key.pressed = quantum_passthrough_press;
-    passthrough_key.released = quantum_passthrough_release;
-    copy_key(&passthrough_key, &layers[16].keys[key_index]);
-    break;
   }
-  return ERR_NONE;
+  SQUIRREL_INSTRUMENT_START(start);
+  if (pressed) {
+    err = find_and_press(ctx, key_index);
+    SQUIRREL_INSTRUMENT_STOP(ctx, INSTRUMENT_PRESS_KEY, start);
+  } else {
+    err = find_and_release(ctx, key_index);
+    SQUIRREL_INSTRUMENT_STOP(ctx, INSTRUMENT_RELEASE_KEY, start);
+  }
+  return err;
+}
+enum squirrel_error key_event_stage(squirrel_key_index_t key_index,
+                                    bool pressed, enum key_stage stage) {
+  return key_event_stage_ctx(&squirrel_default_ctx, key_index, pressed,
+                             stage);
+}
+
+enum squirrel_error press_key_ctx(struct squirrel_ctx *ctx,
+                                  squirrel_key_index_t key_index) {
+  return key_event_stage_ctx(ctx, key_index, true, KEY_STAGE_COMBO);
+}
+enum squirrel_error press_key(squirrel_key_index_t key_index) {
+  return press_key_ctx(&squirrel_default_ctx, key_index);
 }
 
-bool key_states[SQUIRREL_KEYCOUNT];
+enum squirrel_error release_key_ctx(struct squirrel_ctx *ctx,
+                                    squirrel_key_index_t key_index) {
+  return key_event_stage_ctx(ctx, key_index, false, KEY_STAGE_COMBO);
+}
+enum squirrel_error release_key(squirrel_key_index_t key_index) {
+  return release_key_ctx(&squirrel_default_ctx, key_index);
+}
 
-enum squirrel_error check_key(uint8_t key_index, bool is_pressed) {
-  if (key_states[key_index] == is_pressed) {
+enum squirrel_error check_key_ctx(struct squirrel_ctx *ctx,
+                                  squirrel_key_index_t key_index,
+                                  bool is_pressed) {
+  uint32_t bit = 1u << (key_index % 32);
+  uint32_t *word = &ctx->key_states[key_index / 32];
+  if (((*word & bit) != 0) == is_pressed) {
     return ERR_NONE;
   }
   if (is_pressed) {
-    key_states[key_index] = true;
-    return press_key(key_index);
+    *word |= bit;
+    return press_key_ctx(ctx, key_index);
   }
-  key_states[key_index] = false;
-  return release_key(key_index);
+  *word &= ~bit;
+  return release_key_ctx(ctx, key_index);
+}
+enum squirrel_error check_key(squirrel_key_index_t key_index, bool is_pressed) {
+  return check_key_ctx(&squirrel_default_ctx, key_index, is_pressed);
+}
+
+enum squirrel_error check_keys_ctx(struct squirrel_ctx *ctx,
+                                   const uint32_t *bitmap) {
+  uint32_t *key_states = ctx->key_states;
+  for (int w = 0; w < SQUIRREL_KEYSTATE_WORDS; w++) {
+    uint32_t changed = key_states[w] ^ bitmap[w];
+    if (w == SQUIRREL_KEYSTATE_WORDS - 1 && SQUIRREL_KEYCOUNT % 32 != 0) {
+      changed &= (1u << (SQUIRREL_KEYCOUNT % 32)) - 1; // ignore unused bits
+    }
+    // Only visit the keys that changed, lowest index first.
+    while (changed != 0) {
+      uint8_t bit_index = __builtin_ctz(changed);
+      uint32_t bit = 1u << bit_index;
+      changed &= changed - 1;
+      squirrel_key_index_t key_index = w * 32 + bit_index;
+      enum squirrel_error err;
+      if (bitmap[w] & bit) {
+        key_states[w] |= bit;
+        err = press_key_ctx(ctx, key_index);
+      } else {
+        key_states[w] &= ~bit;
+        err = release_key_ctx(ctx, key_index);
+      }
+      if (err != ERR_NONE) {
+        return err;
+      }
+    }
+  }
+  return ERR_NONE;
+}
+enum squirrel_error check_keys(const uint32_t *bitmap) {
+  return check_keys_ctx(&squirrel_default_ctx, bitmap);
 }
@@ -1,32 +1,122 @@
 #include "squirrel_keyboard.h"
+#include "squirrel_ctx.h"
+#include "squirrel_report.h"
 #include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
 
-bool keyboard_keycodes[256] = {false};
-uint8_t keyboard_modifiers = 0;
-
+void keyboard_activate_keycode_ctx(struct squirrel_ctx *ctx, uint8_t keycode) {
+  uint8_t bit = 1u << (keycode % 8);
+  if (ctx->keyboard_report.keycodes[keycode / 8] & bit) {
+    return;
+  }
+  ctx->keyboard_report.keycodes[keycode / 8] |= bit;
+  squirrel_report_transition_ctx(ctx, REPORT_KEYBOARD, keycode, true);
+}
 void keyboard_activate_keycode(uint8_t keycode) {
-  keyboard_keycodes[keycode] = true;
+  keyboard_activate_keycode_ctx(&squirrel_default_ctx, keycode);
+}
+void keyboard_deactivate_keycode_ctx(struct squirrel_ctx *ctx,
+                                     uint8_t keycode) {
+  uint8_t bit = 1u << (keycode % 8);
+  if (!(ctx->keyboard_report.keycodes[keycode / 8] & bit)) {
+    return;
+  }
+  ctx->keyboard_report.keycodes[keycode / 8] &= ~bit;
+  squirrel_report_transition_ctx(ctx, REPORT_KEYBOARD, keycode, false);
 }
 void keyboard_deactivate_keycode(uint8_t keycode) {
-  keyboard_keycodes[keycode] = false;
+  keyboard_deactivate_keycode_ctx(&squirrel_default_ctx, keycode);
 }
-bool keyboard_get_keycodes(uint8_t (*active_keycodes)[6]) {
+bool keyboard_get_keycode_ctx(struct squirrel_ctx *ctx, uint8_t keycode) {
+  return (ctx->keyboard_report.keycodes[keycode / 8] >> (keycode % 8)) & 1;
+}
+bool keyboard_get_keycode(uint8_t keycode) {
+  return keyboard_get_keycode_ctx(&squirrel_default_ctx, keycode);
+}
+bool keyboard_get_keycodes_ctx(struct squirrel_ctx *ctx,
+                               uint8_t (*active_keycodes)[6]) {
+  const uint8_t *keycodes = ctx->keyboard_report.keycodes;
   uint8_t active_keycodes_index = 0;
-  for (int i = 0; (i <= 0xFF) && active_keycodes_index < 6; i++) {
-    if (!keyboard_keycodes[i]) {
+  for (int i = 0; i < 32 && active_keycodes_index < 6; i += 4) {
+    // Skip 32 keycodes at a time while nothing is held.
+    uint32_t word;
+    memcpy(&word, &keycodes[i], sizeof(word));
+    if (word == 0) {
       continue;
     }
-    (*active_keycodes)[active_keycodes_index] = i;
-    active_keycodes_index++;
+    // Only visit the set bits, lowest keycode first.
+    for (int j = i; j < i + 4 && active_keycodes_index < 6; j++) {
+      uint8_t byte = keycodes[j];
+      while (byte != 0 && active_keycodes_index < 6) {
+        (*active_keycodes)[active_keycodes_index] = j * 8 + __builtin_ctz(byte);
+        active_keycodes_index++;
+        byte &= byte - 1;
+      }
+    }
   }
   return active_keycodes_index != 0;
 }
+bool keyboard_get_keycodes(uint8_t (*active_keycodes)[6]) {
+  return keyboard_get_keycodes_ctx(&squirrel_default_ctx, active_keycodes);
+}
 
+void keyboard_activate_modifier_ctx(struct squirrel_ctx *ctx,
+                                    uint8_t modifier) {
+  if ((ctx->keyboard_report.modifiers & modifier) == modifier) {
+    return;
+  }
+  ctx->keyboard_report.modifiers |= modifier;
+  squirrel_report_transition_ctx(ctx, REPORT_MODIFIERS, modifier, true);
+}
 void keyboard_activate_modifier(uint8_t modifier) {
-  keyboard_modifiers |= modifier;
+  keyboard_activate_modifier_ctx(&squirrel_default_ctx, modifier);
+}
+void keyboard_deactivate_modifier_ctx(struct squirrel_ctx *ctx,
+                                      uint8_t modifier) {
+  if ((ctx->keyboard_report.modifiers & modifier) == 0) {
+    return;
+  }
+  ctx->keyboard_report.modifiers &= ~modifier;
+  squirrel_report_transition_ctx(ctx, REPORT_MODIFIERS, modifier, false);
 }
 void keyboard_deactivate_modifier(uint8_t modifier) {
-  keyboard_modifiers &= ~modifier;
+  keyboard_deactivate_modifier_ctx(&squirrel_default_ctx, modifier);
+}
+uint8_t keyboard_get_modifiers_ctx(struct squirrel_ctx *ctx) {
+  return ctx->keyboard_report.modifiers;
+}
+uint8_t keyboard_get_modifiers() {
+  return keyboard_get_modifiers_ctx(&squirrel_default_ctx);
+}
+
+void keyboard_set_report_mode_ctx(struct squirrel_ctx *ctx,
+                                  enum keyboard_report_mode mode) {
+  ctx->keyboard_report_mode = mode;
+}
+void keyboard_set_report_mode(enum keyboard_report_mode mode) {
+  keyboard_set_report_mode_ctx(&squirrel_default_ctx, mode);
+}
+enum keyboard_report_mode
+keyboard_get_report_mode_ctx(struct squirrel_ctx *ctx) {
+  return ctx->keyboard_report_mode;
+}
+enum keyboard_report_mode keyboard_get_report_mode() {
+  return keyboard_get_report_mode_ctx(&squirrel_default_ctx);
+}
+uint8_t keyboard_get_report_ctx(struct squirrel_ctx *ctx,
+                                const uint8_t **report) {
+  if (ctx->keyboard_report_mode == KEYBOARD_REPORT_MODE_NKRO) {
+    *report = (const uint8_t *)&ctx->keyboard_report;
+    return sizeof(ctx->keyboard_report);
+  }
+  struct keyboard_boot_report *boot = &ctx->keyboard_boot_report;
+  memset(boot, 0, sizeof(*boot));
+  boot->modifiers = ctx->keyboard_report.modifiers;
+  keyboard_get_keycodes_ctx(ctx, &boot->keycodes);
+  *report = (const uint8_t *)boot;
+  return sizeof(*boot);
+}
+uint8_t keyboard_get_report(const uint8_t **report) {
+  return keyboard_get_report_ctx(&squirrel_default_ctx, report);
 }
-uint8_t keyboard_get_modifiers() { return keyboard_modifiers; }
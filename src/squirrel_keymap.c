@@ -1,83 +1,84 @@
 #include "squirrel_key.h"
 #include "squirrel_quantum.h"
-#include <stdlib.h>
 
 struct key nop(void) {
   return (struct key){
-      .pressed = key_nop,
-      .released = key_nop,
+      .action = ACTION_NOP,
   };
 }
 
 struct key keyboard(uint8_t keycode) {
-  uint8_t *new_keycode = malloc(sizeof(uint8_t));
-  *new_keycode = keycode;
   return (struct key){
-      .pressed = keyboard_press,
-      .released = keyboard_release,
-      .pressed_argument = new_keycode,
-      .released_argument = new_keycode,
+      .action = ACTION_KEYBOARD,
+      .argument = keycode,
   };
 }
 
 struct key keyboard_modifier(uint8_t modifier) {
-  uint8_t *new_modifier = malloc(sizeof(uint8_t));
-  *new_modifier = modifier;
   return (struct key){
-      .pressed = keyboard_modifier_press,
-      .released = keyboard_modifier_release,
-      .pressed_argument = new_modifier,
-      .released_argument = new_modifier,
+      .action = ACTION_KEYBOARD_MODIFIER,
+      .argument = modifier,
   };
 }
 
 struct key consumer(uint16_t consumer) {
-  uint16_t *new_consumer = malloc(sizeof(uint16_t));
-  *new_consumer = consumer;
   return (struct key){
-      .pressed = consumer_press,
-      .released = consumer_release,
-      .pressed_argument = new_consumer,
-      .released_argument = new_consumer,
+      .action = ACTION_CONSUMER,
+      .argument = consumer,
   };
 }
 
 struct key passthrough(void) {
   return (struct key){
-      .pressed = quantum_passthrough_press,
-      .released = quantum_passthrough_release,
+      .action = ACTION_PASSTHROUGH,
   };
 }
 
 struct key layer_momentary(uint8_t layer) {
-  uint8_t *new_layer = malloc(sizeof(uint8_t));
-  *new_layer = layer;
   return (struct key){
-      .pressed = layer_momentary_press,
-      .released = layer_momentary_release,
-      .pressed_argument = new_layer,
-      .released_argument = new_layer,
+      .action = ACTION_LAYER_MOMENTARY,
+      .argument = layer,
   };
 }
 
 struct key layer_toggle(uint8_t layer) {
-  uint8_t *new_layer = malloc(sizeof(uint8_t));
-  *new_layer = layer;
   return (struct key){
-      .pressed = layer_toggle_press,
-      .released = layer_toggle_release,
-      .pressed_argument = new_layer,
-      .released_argument = new_layer,
+      .action = ACTION_LAYER_TOGGLE,
+      .argument = layer,
   };
 }
 
 struct key layer_solo(uint8_t layer) {
-  uint8_t *new_layer = malloc(sizeof(uint8_t));
-  *new_layer = layer;
   return (struct key){
-      .pressed = layer_solo_press,
-      .released = layer_solo_release,
-      .pressed_argument = new_layer,
-      .released_argument = new_layer,
+      .action = ACTION_LAYER_SOLO,
+      .argument = layer,
+  };
+}
+
+struct key mod_tap(uint8_t modifier, uint8_t keycode) {
+  return (struct key){
+      .action = ACTION_MOD_TAP,
+      .argument = modifier << 8 | keycode,
+  };
+}
+
+struct key layer_tap(uint8_t layer, uint8_t keycode) {
+  return (struct key){
+      .action = ACTION_LAYER_TAP,
+      .argument = layer << 8 | keycode,
+  };
+}
+
+struct key macro(uint8_t index) {
+  return (struct key){
+      .action = ACTION_MACRO,
+      .argument = index,
+  };
+}
+
+struct key custom(uint8_t index, uint16_t argument) {
+  return (struct key){
+      .action = ACTION_CUSTOM + index,
+      .argument = argument,
   };
 }
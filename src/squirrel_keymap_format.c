@@ -0,0 +1,266 @@
+#include "squirrel_keymap_format.h"
+#include "squirrel.h"
+#include "squirrel_ctx.h"
+#include "squirrel_key.h"
+#include "squirrel_quantum.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+static const uint8_t magic[4] = {'S', 'Q', 'K', 'M'};
+
+static uint16_t read16(const uint8_t *p) { return p[0] | p[1] << 8; }
+
+static uint32_t read32(const uint8_t *p) {
+  return (uint32_t)read16(p) | (uint32_t)read16(p + 2) << 16;
+}
+
+static void write16(uint8_t *p, uint16_t value) {
+  p[0] = value & 0xFF;
+  p[1] = value >> 8;
+}
+
+static void write32(uint8_t *p, uint32_t value) {
+  write16(p, value & 0xFFFF);
+  write16(p + 2, value >> 16);
+}
+
+// check_layer_keys returns true if none of the count keys names a layer from
+// SQUIRREL_LAYER_COUNT on, which the layer actions could not shift into a
+// squirrel_layer_mask_t.
+static bool check_layer_keys(const struct key *keys, uint32_t count) {
+  for (uint32_t i = 0; i < count; i++) {
+    uint16_t layer;
+    switch (keys[i].action) {
+    case ACTION_LAYER_MOMENTARY:
+    case ACTION_LAYER_TOGGLE:
+    case ACTION_LAYER_SOLO:
+      layer = keys[i].argument;
+      break;
+    case ACTION_LAYER_TAP:
+      layer = keys[i].argument >> 8;
+      break;
+    default:
+      continue;
+    }
+    if (layer >= SQUIRREL_LAYER_COUNT) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// check_layer returns true if the layer table entry at entry describes valid
+// keys that lie within the first size bytes of keymap, after the layer table.
+static bool check_layer(const uint8_t *keymap, const uint8_t *entry,
+                        uint32_t table_end, uint32_t size) {
+  uint8_t kind = entry[0];
+  uint16_t stored = read16(entry + 2);
+  uint32_t offset = read32(entry + 4);
+  if (entry[1] != 0) {
+    return false;
+  }
+  if (kind == KEYMAP_LAYER_EMPTY) {
+    return stored == 0 && offset == 0;
+  }
+  if (offset % 4 != 0 || offset < table_end || offset > size) {
+    return false;
+  }
+  uint32_t available = size - offset;
+  if (kind == KEYMAP_LAYER_DENSE) {
+    return stored == SQUIRREL_KEYCOUNT &&
+           available / sizeof(struct key) >= SQUIRREL_KEYCOUNT &&
+           check_layer_keys((const struct key *)(keymap + offset), stored);
+  }
+  if (kind != KEYMAP_LAYER_SPARSE) {
+    return false;
+  }
+  uint32_t present_size = SQUIRREL_KEYSTATE_WORDS * sizeof(uint32_t);
+  if (available < present_size ||
+      (available - present_size) / sizeof(struct key) < stored) {
+    return false;
+  }
+  // The bitmap must have one bit per stored key, and none past the last key.
+  const uint32_t *present = (const uint32_t *)(keymap + offset);
+  uint32_t count = 0;
+  for (int w = 0; w < SQUIRREL_KEYSTATE_WORDS; w++) {
+    count += __builtin_popcount(present[w]);
+  }
+  uint32_t last = present[SQUIRREL_KEYSTATE_WORDS - 1];
+  if (SQUIRREL_KEYCOUNT % 32 != 0 && last >> (SQUIRREL_KEYCOUNT % 32) != 0) {
+    return false;
+  }
+  const struct key *keys = (const struct key *)(keymap + offset + present_size);
+  return count == stored && check_layer_keys(keys, stored);
+}
+
+// check_keymap returns true if keymap holds a keymap this build can use in
+// place.
+static bool check_keymap(const uint8_t *keymap, size_t size) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  return false; // the keys could not be used without swapping their bytes
+#endif
+  if ((uintptr_t)keymap % 4 != 0 || size < KEYMAP_FORMAT_HEADER_SIZE) {
+    return false;
+  }
+  uint8_t layer_count = keymap[8];
+  uint32_t total = read32(keymap + 12);
+  uint32_t table_end =
+      KEYMAP_FORMAT_HEADER_SIZE + layer_count * KEYMAP_FORMAT_LAYER_SIZE;
+  if (memcmp(keymap, magic, sizeof(magic)) != 0 ||
+      read16(keymap + 4) != KEYMAP_FORMAT_VERSION ||
+      read16(keymap + 6) != SQUIRREL_KEYCOUNT ||
+      layer_count > SQUIRREL_LAYER_COUNT || keymap[9] != 0 ||
+      keymap[10] != 0 || keymap[11] != 0 || total > size ||
+      total < table_end) {
+    return false;
+  }
+  for (uint8_t layer = 0; layer < layer_count; layer++) {
+    const uint8_t *entry = keymap + KEYMAP_FORMAT_HEADER_SIZE +
+                           layer * KEYMAP_FORMAT_LAYER_SIZE;
+    if (!check_layer(keymap, entry, table_end, total)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+enum squirrel_error keymap_load_ctx(struct squirrel_ctx *ctx,
+                                    const void *buffer, size_t size) {
+  const uint8_t *keymap = buffer;
+  if (!check_keymap(keymap, size)) {
+    return ERR_KEYMAP_INVALID;
+  }
+  uint8_t layer_count = keymap[8];
+  release_held_keys(ctx, LAYER_MASK_ALL);
+  for (uint8_t layer = 0; layer < SQUIRREL_LAYER_COUNT; layer++) {
+    struct layer *l = &ctx->layers[layer];
+    l->keys = NULL;
+    l->present = NULL;
+    if (layer >= layer_count) {
+      continue;
+    }
+    const uint8_t *entry = keymap + KEYMAP_FORMAT_HEADER_SIZE +
+                           layer * KEYMAP_FORMAT_LAYER_SIZE;
+    const uint8_t *keys = keymap + read32(entry + 4);
+    if (entry[0] == KEYMAP_LAYER_DENSE) {
+      l->keys = (const struct key *)keys;
+    } else if (entry[0] == KEYMAP_LAYER_SPARSE) {
+      l->present = (const uint32_t *)keys;
+      l->keys = (const struct key *)(keys + SQUIRREL_KEYSTATE_WORDS *
+                                                sizeof(uint32_t));
+    }
+  }
+  // Every layer changed, so every edit is dropped at once.
+  ctx->overlay.count = 0;
+  memset(ctx->overlay.present, 0, sizeof(ctx->overlay.present));
+  layer_invalidate_cache_ctx(ctx);
+  return ERR_NONE;
+}
+enum squirrel_error keymap_load(const void *buffer, size_t size) {
+  return keymap_load_ctx(&squirrel_default_ctx, buffer, size);
+}
+
+// layer_size returns the number of bytes the keys of a layer take up.
+static uint32_t layer_size(enum keymap_layer_kind kind, uint16_t stored) {
+  uint32_t size = stored * sizeof(struct key);
+  if (kind == KEYMAP_LAYER_SPARSE) {
+    size += SQUIRREL_KEYSTATE_WORDS * sizeof(uint32_t);
+  }
+  return size;
+}
+
+// layer_stored returns the number of keys of the layer that do not pass
+// through, and sets kind to the smallest way to store them.
+static uint16_t layer_stored(struct squirrel_ctx *ctx, uint8_t layer,
+                             enum keymap_layer_kind *kind) {
+  uint16_t count = 0;
+  for (int i = 0; i < SQUIRREL_KEYCOUNT; i++) {
+    if (layer_get_key_ctx(ctx, layer, i).action != ACTION_PASSTHROUGH) {
+      count++;
+    }
+  }
+  if (count == 0) {
+    *kind = KEYMAP_LAYER_EMPTY;
+    return 0;
+  }
+  if (layer_size(KEYMAP_LAYER_SPARSE, count) <
+      layer_size(KEYMAP_LAYER_DENSE, SQUIRREL_KEYCOUNT)) {
+    *kind = KEYMAP_LAYER_SPARSE;
+    return count;
+  }
+  *kind = KEYMAP_LAYER_DENSE;
+  return SQUIRREL_KEYCOUNT;
+}
+
+// write_layer writes the keys of a layer at out.
+static void write_layer(struct squirrel_ctx *ctx, uint8_t layer,
+                        enum keymap_layer_kind kind, uint8_t *out) {
+  if (kind == KEYMAP_LAYER_SPARSE) {
+    uint8_t *present = out;
+    memset(present, 0, SQUIRREL_KEYSTATE_WORDS * sizeof(uint32_t));
+    out += SQUIRREL_KEYSTATE_WORDS * sizeof(uint32_t);
+    for (int i = 0; i < SQUIRREL_KEYCOUNT; i++) {
+      if (layer_get_key_ctx(ctx, layer, i).action != ACTION_PASSTHROUGH) {
+        present[i / 8] |= 1u << (i % 8); // little endian words
+      }
+    }
+  }
+  for (int i = 0; i < SQUIRREL_KEYCOUNT; i++) {
+    struct key key = layer_get_key_ctx(ctx, layer, i);
+    if (kind == KEYMAP_LAYER_SPARSE && key.action == ACTION_PASSTHROUGH) {
+      continue;
+    }
+    write16(out, key.action);
+    write16(out + 2, key.argument);
+    out += sizeof(struct key);
+  }
+}
+
+enum squirrel_error keymap_save_ctx(struct squirrel_ctx *ctx, void *buffer,
+                                    size_t size, size_t *written) {
+  enum keymap_layer_kind kinds[SQUIRREL_LAYER_COUNT];
+  uint16_t stored[SQUIRREL_LAYER_COUNT];
+  // Layers past the last one with keys are left out.
+  uint8_t layer_count = 0;
+  uint32_t keys_size = 0;
+  for (uint8_t layer = 0; layer < SQUIRREL_LAYER_COUNT; layer++) {
+    stored[layer] = layer_stored(ctx, layer, &kinds[layer]);
+    keys_size += layer_size(kinds[layer], stored[layer]);
+    if (kinds[layer] != KEYMAP_LAYER_EMPTY) {
+      layer_count = layer + 1;
+    }
+  }
+  uint32_t offset =
+      KEYMAP_FORMAT_HEADER_SIZE + layer_count * KEYMAP_FORMAT_LAYER_SIZE;
+  *written = offset + keys_size;
+  if (*written > size) {
+    return ERR_KEYMAP_TOO_SMALL;
+  }
+  uint8_t *out = buffer;
+  memcpy(out, magic, sizeof(magic));
+  write16(out + 4, KEYMAP_FORMAT_VERSION);
+  write16(out + 6, SQUIRREL_KEYCOUNT);
+  out[8] = layer_count;
+  memset(out + 9, 0, 3);
+  write32(out + 12, *written);
+  for (uint8_t layer = 0; layer < layer_count; layer++) {
+    uint8_t *entry =
+        out + KEYMAP_FORMAT_HEADER_SIZE + layer * KEYMAP_FORMAT_LAYER_SIZE;
+    entry[0] = kinds[layer];
+    entry[1] = 0;
+    write16(entry + 2, stored[layer]);
+    if (kinds[layer] == KEYMAP_LAYER_EMPTY) {
+      write32(entry + 4, 0);
+      continue;
+    }
+    write32(entry + 4, offset);
+    write_layer(ctx, layer, kinds[layer], out + offset);
+    offset += layer_size(kinds[layer], stored[layer]);
+  }
+  return ERR_NONE;
+}
+enum squirrel_error keymap_save(void *buffer, size_t size, size_t *written) {
+  return keymap_save_ctx(&squirrel_default_ctx, buffer, size, written);
+}
@@ -0,0 +1,212 @@
+#include "squirrel_macro.h"
+#include "squirrel.h"
+#include "squirrel_ctx.h"
+#include "squirrel_keyboard.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+// SHIFTED is set in an ascii_keycode result for characters typed with shift.
+#define SHIFTED 0x80
+#define LEFT_SHIFT 0x02
+
+// punctuation holds the keycodes of the characters ascii_keycode does not
+// compute, or 0 for the characters that cannot be typed.
+static const uint8_t punctuation[128] = {
+    ['\n'] = 0x28,          ['\t'] = 0x2B,          [' '] = 0x2C,
+    ['!'] = SHIFTED | 0x1E, ['@'] = SHIFTED | 0x1F, ['#'] = SHIFTED | 0x20,
+    ['$'] = SHIFTED | 0x21, ['%'] = SHIFTED | 0x22, ['^'] = SHIFTED | 0x23,
+    ['&'] = SHIFTED | 0x24, ['*'] = SHIFTED | 0x25, ['('] = SHIFTED | 0x26,
+    [')'] = SHIFTED | 0x27, ['-'] = 0x2D,           ['_'] = SHIFTED | 0x2D,
+    ['='] = 0x2E,           ['+'] = SHIFTED | 0x2E, ['['] = 0x2F,
+    ['{'] = SHIFTED | 0x2F, [']'] = 0x30,           ['}'] = SHIFTED | 0x30,
+    ['\\'] = 0x31,          ['|'] = SHIFTED | 0x31, [';'] = 0x33,
+    [':'] = SHIFTED | 0x33, ['\''] = 0x34,          ['"'] = SHIFTED | 0x34,
+    ['`'] = 0x35,           ['~'] = SHIFTED | 0x35, [','] = 0x36,
+    ['<'] = SHIFTED | 0x36, ['.'] = 0x37,           ['>'] = SHIFTED | 0x37,
+    ['/'] = 0x38,           ['?'] = SHIFTED | 0x38,
+};
+
+// ascii_keycode returns the keycode that types the character on a US layout,
+// with SHIFTED set if it needs shift, or 0 if it cannot be typed.
+static uint8_t ascii_keycode(uint8_t c) {
+  if (c >= 'a' && c <= 'z') {
+    return 0x04 + (c - 'a');
+  }
+  if (c >= 'A' && c <= 'Z') {
+    return SHIFTED | (0x04 + (c - 'A'));
+  }
+  if (c >= '1' && c <= '9') {
+    return 0x1E + (c - '1');
+  }
+  if (c == '0') {
+    return 0x27;
+  }
+  return c < 128 ? punctuation[c] : 0;
+}
+
+enum squirrel_error macro_set_table_ctx(struct squirrel_ctx *ctx,
+                                        const uint8_t *const *macros,
+                                        uint8_t count) {
+  struct macro_state *ms = &ctx->macros;
+  if (macro_playing_ctx(ctx)) {
+    return ERR_MACRO_PLAYING;
+  }
+  memset(ms, 0, sizeof(*ms));
+  ms->macros = macros;
+  ms->count = count;
+  return ERR_NONE;
+}
+enum squirrel_error macro_set_table(const uint8_t *const *macros,
+                                    uint8_t count) {
+  return macro_set_table_ctx(&squirrel_default_ctx, macros, count);
+}
+
+enum squirrel_error macro_play_ctx(struct squirrel_ctx *ctx, uint8_t macro) {
+  struct macro_state *ms = &ctx->macros;
+  if (macro >= ms->count) {
+    return ERR_MACRO_INVALID;
+  }
+  if (ms->queued == SQUIRREL_MACRO_QUEUE_SIZE) {
+    return ERR_MACRO_QUEUE_FULL;
+  }
+  uint8_t tail = (ms->head + ms->queued) % SQUIRREL_MACRO_QUEUE_SIZE;
+  ms->queue[tail] = (struct macro_playback){.macro = macro, .position = 0};
+  ms->queued++;
+  return ERR_NONE;
+}
+enum squirrel_error macro_play(uint8_t macro) {
+  return macro_play_ctx(&squirrel_default_ctx, macro);
+}
+
+bool macro_playing_ctx(struct squirrel_ctx *ctx) {
+  return ctx->macros.queued != 0;
+}
+bool macro_playing(void) { return macro_playing_ctx(&squirrel_default_ctx); }
+
+// finish removes the playing macro from the queue, so the next one starts.
+static void finish(struct macro_state *ms) {
+  ms->head = (ms->head + 1) % SQUIRREL_MACRO_QUEUE_SIZE;
+  ms->queued--;
+  ms->wait = 0;
+  ms->step = 0;
+  ms->text = false;
+}
+
+// type_character makes the next change needed to type the character c of a
+// MACRO_TEXT: shift, press, release, then shift again if it was needed. It
+// returns true once the character is typed.
+static bool type_character(struct squirrel_ctx *ctx, uint8_t c) {
+  struct macro_state *ms = &ctx->macros;
+  uint8_t keycode = ascii_keycode(c);
+  if (ms->step == 0) {
+    ms->step = 1;
+    if ((keycode & SHIFTED) &&
+        !(keyboard_get_modifiers_ctx(ctx) & LEFT_SHIFT)) {
+      keyboard_activate_modifier_ctx(ctx, LEFT_SHIFT);
+      ms->shifted = true;
+      return false;
+    }
+  }
+  switch (ms->step) {
+  case 1:
+    keyboard_activate_keycode_ctx(ctx, keycode & ~SHIFTED);
+    ms->step = 2;
+    return false;
+  case 2:
+    keyboard_deactivate_keycode_ctx(ctx, keycode & ~SHIFTED);
+    if (ms->shifted) {
+      ms->step = 3;
+      return false;
+    }
+    break;
+  default:
+    keyboard_deactivate_modifier_ctx(ctx, LEFT_SHIFT);
+    ms->shifted = false;
+    break;
+  }
+  ms->step = 0;
+  return true;
+}
+
+enum squirrel_error macro_step_ctx(struct squirrel_ctx *ctx) {
+  struct macro_state *ms = &ctx->macros;
+  while (ms->queued != 0) {
+    if (ms->wait > 0) {
+      ms->wait--;
+      return ERR_NONE;
+    }
+    struct macro_playback *playing = &ms->queue[ms->head];
+    const uint8_t *next = ms->macros[playing->macro] + playing->position;
+    if (ms->text) {
+      if (next[0] == 0) {
+        ms->text = false;
+        playing->position++;
+      } else if (ascii_keycode(next[0]) == 0) {
+        playing->position++; // skipped, so it makes no change
+      } else {
+        if (type_character(ctx, next[0])) {
+          playing->position++;
+        }
+        return ERR_NONE;
+      }
+      continue;
+    }
+    switch (next[0]) {
+    case MACRO_END:
+      finish(ms);
+      continue;
+    case MACRO_PRESS:
+      keyboard_activate_keycode_ctx(ctx, next[1]);
+      playing->position += 2;
+      return ERR_NONE;
+    case MACRO_RELEASE:
+      keyboard_deactivate_keycode_ctx(ctx, next[1]);
+      playing->position += 2;
+      return ERR_NONE;
+    case MACRO_TAP:
+      if (ms->step == 0) {
+        keyboard_activate_keycode_ctx(ctx, next[1]);
+        ms->step = 1;
+      } else {
+        keyboard_deactivate_keycode_ctx(ctx, next[1]);
+        ms->step = 0;
+        playing->position += 2;
+      }
+      return ERR_NONE;
+    case MACRO_MODIFIER_PRESS:
+      keyboard_activate_modifier_ctx(ctx, next[1]);
+      playing->position += 2;
+      return ERR_NONE;
+    case MACRO_MODIFIER_RELEASE:
+      keyboard_deactivate_modifier_ctx(ctx, next[1]);
+      playing->position += 2;
+      return ERR_NONE;
+    case MACRO_DELAY:
+      ms->wait = next[1] | next[2] << 8;
+      playing->position += 3;
+      continue;
+    case MACRO_TEXT:
+      ms->text = true;
+      playing->position++;
+      continue;
+    default:
+      finish(ms);
+      return ERR_MACRO_INVALID;
+    }
+  }
+  return ERR_NONE;
+}
+enum squirrel_error macro_step(void) {
+  return macro_step_ctx(&squirrel_default_ctx);
+}
+
+enum squirrel_error macro_press(struct squirrel_ctx *ctx, uint8_t layer,
+                                squirrel_key_index_t key_index, uint16_t arg) {
+  (void)layer;
+  (void)key_index;
+  if (arg > UINT8_MAX) {
+    return ERR_MACRO_INVALID;
+  }
+  return macro_play_ctx(ctx, arg);
+}
@@ -1,157 +1,701 @@
 #include "squirrel_quantum.h"
 #include "squirrel.h"
 #include "squirrel_consumer.h"
+#include "squirrel_ctx.h"
+#include "squirrel_instrument.h"
 #include "squirrel_key.h"
 #include "squirrel_keyboard.h"
+#include "squirrel_macro.h"
+#include "squirrel_timer.h"
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
-struct layer layers[17] = {};
+const struct action actions[ACTION_BUILTIN_COUNT] = {
+    [ACTION_PASSTHROUGH] = {quantum_passthrough_press,
+                            quantum_passthrough_release},
+    [ACTION_NOP] = {key_nop, key_nop},
+    [ACTION_KEYBOARD] = {keyboard_press, keyboard_release},
+    [ACTION_KEYBOARD_MODIFIER] = {keyboard_modifier_press,
+                                  keyboard_modifier_release},
+    [ACTION_CONSUMER] = {consumer_press, consumer_release},
+    [ACTION_LAYER_MOMENTARY] = {layer_momentary_press, layer_momentary_release},
+    [ACTION_LAYER_TOGGLE] = {layer_toggle_press, layer_toggle_release},
+    [ACTION_LAYER_SOLO] = {layer_solo_press, layer_solo_release},
+    [ACTION_MOD_TAP] = {mod_tap_press, mod_tap_release},
+    [ACTION_LAYER_TAP] = {layer_tap_press, layer_tap_release},
+    [ACTION_MACRO] = {macro_press, key_nop},
+};
+
+// highest_layer returns the highest layer in a mask, which must not be empty.
+static uint8_t highest_layer(squirrel_layer_mask_t mask) {
+#if SQUIRREL_LAYER_COUNT > 32
+  return 63 - __builtin_clzll(mask);
+#else
+  return 31 - __builtin_clz(mask);
+#endif
+}
+
+// lowest_layer returns the lowest layer in a mask, which must not be empty.
+static uint8_t lowest_layer(squirrel_layer_mask_t mask) {
+#if SQUIRREL_LAYER_COUNT > 32
+  return __builtin_ctzll(mask);
+#else
+  return __builtin_ctz(mask);
+#endif
+}
+
+// overlay_id orders overlay entries by layer, then by key index.
+static uint32_t overlay_id(uint8_t layer, squirrel_key_index_t key_index) {
+  return ((uint32_t)layer << 16) | key_index;
+}
+
+// overlay_find returns the position of the entry for the key, or the position
+// it would be inserted at if there is none.
+static uint16_t overlay_find(const struct keymap_overlay *overlay,
+                             uint8_t layer, squirrel_key_index_t key_index) {
+  uint32_t id = overlay_id(layer, key_index);
+  uint16_t low = 0;
+  uint16_t high = overlay->count;
+  while (low < high) {
+    uint16_t mid = (low + high) / 2;
+    const struct keymap_overlay_entry *entry = &overlay->entries[mid];
+    if (overlay_id(entry->layer, entry->key_index) < id) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return low;
+}
+
+static bool overlay_has(const struct keymap_overlay *overlay, uint8_t layer,
+                        squirrel_key_index_t key_index) {
+  return (overlay->present[layer][key_index / 32] >> (key_index % 32)) & 1;
+}
+
+// sparse_rank returns the position of a present key in a sparse layer's keys:
+// the number of present keys before it.
+static uint16_t sparse_rank(const uint32_t *present,
+                            squirrel_key_index_t key_index) {
+  uint16_t rank = 0;
+  for (int w = 0; w < key_index / 32; w++) {
+    rank += __builtin_popcount(present[w]);
+  }
+  uint32_t below = (1u << (key_index % 32)) - 1;
+  return rank + __builtin_popcount(present[key_index / 32] & below);
+}
+
+// base_key returns the key at the index in the layer's base keymap.
+static struct key base_key(const struct layer *l,
+                           squirrel_key_index_t key_index) {
+  if (l->present != NULL) {
+    if (!((l->present[key_index / 32] >> (key_index % 32)) & 1)) {
+      return (struct key){.action = ACTION_PASSTHROUGH};
+    }
+    return l->keys[sparse_rank(l->present, key_index)];
+  }
+  if (l->keys == NULL) {
+    return (struct key){.action = ACTION_PASSTHROUGH};
+  }
+  return l->keys[key_index];
+}
+
+// passes_through returns true if the key at the index in the layer passes
+// through. Keys of sparse layers are checked with a single bit test.
+static bool passes_through(const struct squirrel_ctx *ctx, uint8_t layer,
+                           squirrel_key_index_t key_index) {
+  const struct keymap_overlay *overlay = &ctx->overlay;
+  if (overlay_has(overlay, layer, key_index)) {
+    return overlay->entries[overlay_find(overlay, layer, key_index)]
+               .key.action == ACTION_PASSTHROUGH;
+  }
+  const struct layer *l = &ctx->layers[layer];
+  if (l->present != NULL) {
+    return !((l->present[key_index / 32] >> (key_index % 32)) & 1);
+  }
+  return l->keys == NULL || l->keys[key_index].action == ACTION_PASSTHROUGH;
+}
+
+struct key layer_get_key_ctx(struct squirrel_ctx *ctx, uint8_t layer,
+                             squirrel_key_index_t key_index) {
+  const struct keymap_overlay *overlay = &ctx->overlay;
+  if (overlay_has(overlay, layer, key_index)) {
+    return overlay->entries[overlay_find(overlay, layer, key_index)].key;
+  }
+  return base_key(&ctx->layers[layer], key_index);
+}
+struct key layer_get_key(uint8_t layer, squirrel_key_index_t key_index) {
+  return layer_get_key_ctx(&squirrel_default_ctx, layer, key_index);
+}
+
+void hold_key(struct squirrel_ctx *ctx, uint8_t layer,
+              squirrel_key_index_t key_index) {
+  ctx->held_from_layer[key_index] = layer;
+  ctx->held_keys[key_index / 32] |= 1u << (key_index % 32);
+}
+
+// release_held_key releases the held key at the index, as it was pressed.
+static void release_held_key(struct squirrel_ctx *ctx,
+                             squirrel_key_index_t key_index) {
+  uint8_t layer = ctx->held_from_layer[key_index];
+  ctx->held_from_layer[key_index] = LAYER_NONE;
+  dispatch_release_ctx(ctx, layer_get_key_ctx(ctx, layer, key_index), layer,
+                       key_index);
+}
+
+void release_held_keys(struct squirrel_ctx *ctx,
+                       squirrel_layer_mask_t layers) {
+  for (int w = 0; w < SQUIRREL_KEYSTATE_WORDS; w++) {
+    for (uint32_t bits = ctx->held_keys[w]; bits != 0; bits &= bits - 1) {
+      squirrel_key_index_t key_index = w * 32 + __builtin_ctz(bits);
+      uint8_t layer = ctx->held_from_layer[key_index];
+      if (layer != LAYER_NONE && (layers & LAYER_BIT(layer))) {
+        release_held_key(ctx, key_index);
+      }
+    }
+  }
+}
+
+// set_base replaces the base keymap of the layer, and forgets its edits.
+static void set_base(struct squirrel_ctx *ctx, uint8_t layer,
+                     const uint32_t *present, const struct key *keys) {
+  release_held_keys(ctx, LAYER_BIT(layer));
+  ctx->layers[layer].keys = keys;
+  ctx->layers[layer].present = present;
+  // Drop the layer's edits, keeping the rest of the overlay in order.
+  struct keymap_overlay *overlay = &ctx->overlay;
+  uint16_t kept = 0;
+  for (uint16_t i = 0; i < overlay->count; i++) {
+    if (overlay->entries[i].layer != layer) {
+      overlay->entries[kept++] = overlay->entries[i];
+    }
+  }
+  overlay->count = kept;
+  memset(overlay->present[layer], 0, sizeof(overlay->present[layer]));
+  if (ctx->active_layers & LAYER_BIT(layer)) {
+    layer_invalidate_cache_ctx(ctx);
+  }
+}
+
+void layer_set_keymap_ctx(struct squirrel_ctx *ctx, uint8_t layer,
+                          const struct key *keys) {
+  set_base(ctx, layer, NULL, keys);
+}
+void layer_set_keymap(uint8_t layer, const struct key *keys) {
+  layer_set_keymap_ctx(&squirrel_default_ctx, layer, keys);
+}
+
+void layer_set_sparse_keymap_ctx(struct squirrel_ctx *ctx, uint8_t layer,
+                                 const uint32_t *present,
+                                 const struct key *keys) {
+  set_base(ctx, layer, present, keys);
+}
+void layer_set_sparse_keymap(uint8_t layer, const uint32_t *present,
+                             const struct key *keys) {
+  layer_set_sparse_keymap_ctx(&squirrel_default_ctx, layer, present, keys);
+}
+
+void layer_invalidate_cache_ctx(struct squirrel_ctx *ctx) {
+  memset(ctx->resolved_layers_valid, 0, sizeof(ctx->resolved_layers_valid));
+}
+void layer_invalidate_cache(void) {
+  layer_invalidate_cache_ctx(&squirrel_default_ctx);
+}
+
+uint8_t resolve_layer_ctx(struct squirrel_ctx *ctx,
+                          squirrel_key_index_t key_index) {
+  uint32_t bit = 1u << (key_index % 32);
+  uint32_t *valid = &ctx->resolved_layers_valid[key_index / 32];
+  if (*valid & bit) {
+    return ctx->resolved_layers[key_index];
+  }
+  SQUIRREL_INSTRUMENT_START(start);
+  uint8_t resolved = LAYER_NONE;
+  uint8_t depth = 0;
+  squirrel_layer_mask_t remaining = ctx->active_layers;
+  while (remaining != 0) {
+    resolved = highest_layer(remaining);
+    if (!passes_through(ctx, resolved, key_index)) {
+      break;
+    }
+    remaining &= ~LAYER_BIT(resolved);
+    depth++;
+  }
+  (void)depth;
+  SQUIRREL_INSTRUMENT_DEPTH(ctx, depth);
+  SQUIRREL_INSTRUMENT_STOP(ctx, INSTRUMENT_PASSTHROUGH, start);
+  ctx->resolved_layers[key_index] = resolved;
+  *valid |= bit;
+  return resolved;
+}
+uint8_t resolve_layer(squirrel_key_index_t key_index) {
+  return resolve_layer_ctx(&squirrel_default_ctx, key_index);
+}
+
+enum squirrel_error layer_set_key_ctx(struct squirrel_ctx *ctx, uint8_t layer,
+                                      squirrel_key_index_t key_index,
+                                      struct key key) {
+  struct keymap_overlay *overlay = &ctx->overlay;
+  struct keymap_overlay_entry *entries = overlay->entries;
+  struct key base = base_key(&ctx->layers[layer], key_index);
+  bool held = (ctx->held_keys[key_index / 32] >> (key_index % 32)) & 1;
+  if (held && ctx->held_from_layer[key_index] == layer) {
+    struct key old = layer_get_key_ctx(ctx, layer, key_index);
+    if (old.action != key.action || old.argument != key.argument) {
+      release_held_key(ctx, key_index);
+    }
+  }
+  bool is_base = key.action == base.action && key.argument == base.argument;
+  uint16_t i = overlay_find(overlay, layer, key_index);
+  if (overlay_has(overlay, layer, key_index)) {
+    if (is_base) {
+      // Back to the base keymap, so the edit is no longer needed.
+      memmove(&entries[i], &entries[i + 1],
+              (overlay->count - i - 1) * sizeof(entries[0]));
+      overlay->count--;
+      overlay->present[layer][key_index / 32] &= ~(1u << (key_index % 32));
+    } else {
+      entries[i].key = key;
+    }
+  } else if (!is_base) {
+    if (overlay->count == SQUIRREL_KEYMAP_OVERLAY_CAPACITY) {
+      return ERR_KEYMAP_OVERLAY_FULL;
+    }
+    memmove(&entries[i + 1], &entries[i],
+            (overlay->count - i) * sizeof(entries[0]));
+    entries[i] = (struct keymap_overlay_entry){
+        .layer = layer, .key_index = key_index, .key = key};
+    overlay->count++;
+    overlay->present[layer][key_index / 32] |= 1u << (key_index % 32);
+  }
+  if (ctx->active_layers & LAYER_BIT(layer)) {
+    ctx->resolved_layers_valid[key_index / 32] &= ~(1u << (key_index % 32));
+  }
+  return ERR_NONE;
+}
+enum squirrel_error layer_set_key(uint8_t layer, squirrel_key_index_t key_index,
+                                  struct key key) {
+  return layer_set_key_ctx(&squirrel_default_ctx, layer, key_index, key);
+}
+
+void layer_set_active_mask_ctx(struct squirrel_ctx *ctx,
+                               squirrel_layer_mask_t mask) {
+  mask &= LAYER_MASK_ALL;
+  // Only touch the compatibility flags of the layers that changed.
+  squirrel_layer_mask_t changed = ctx->active_layers ^ mask;
+  ctx->active_layers = mask;
+  if (changed != 0) {
+    layer_invalidate_cache_ctx(ctx);
+  }
+  while (changed != 0) {
+    uint8_t i = lowest_layer(changed);
+    ctx->layers[i].active = (mask >> i) & 1;
+    changed &= changed - 1;
+  }
+}
+void layer_set_active_mask(squirrel_layer_mask_t mask) {
+  layer_set_active_mask_ctx(&squirrel_default_ctx, mask);
+}
+
+void layer_set_active_ctx(struct squirrel_ctx *ctx, uint8_t layer,
+                          bool active) {
+  if (active) {
+    layer_set_active_mask_ctx(ctx, ctx->active_layers | LAYER_BIT(layer));
+    return;
+  }
+  layer_set_active_mask_ctx(ctx, ctx->active_layers & ~LAYER_BIT(layer));
+}
+void layer_set_active(uint8_t layer, bool active) {
+  layer_set_active_ctx(&squirrel_default_ctx, layer, active);
+}
 
-enum squirrel_error key_nop(uint8_t layer, uint8_t key_index, void *arg) {
+enum squirrel_error key_nop(struct squirrel_ctx *ctx, uint8_t layer,
+                            squirrel_key_index_t key_index, uint16_t arg) {
   (void)arg;
   return ERR_NONE;
 }
 
-enum squirrel_error keyboard_press(uint8_t layer, uint8_t key_index,
-                                   void *arg) {
+enum squirrel_error keyboard_press(struct squirrel_ctx *ctx, uint8_t layer,
+                                   squirrel_key_index_t key_index,
+                                   uint16_t arg) {
   (void)layer;
   (void)key_index;
-  keyboard_activate_keycode(*(uint8_t *)arg); // squirrel_keyboard
+  keyboard_activate_keycode_ctx(ctx, arg); // squirrel_keyboard
   return ERR_NONE;
 };
 
-enum squirrel_error keyboard_release(uint8_t layer, uint8_t key_index,
-                                     void *arg) {
+enum squirrel_error keyboard_release(struct squirrel_ctx *ctx, uint8_t layer,
+                                     squirrel_key_index_t key_index,
+                                     uint16_t arg) {
   (void)layer;
   (void)key_index;
-  keyboard_deactivate_keycode(*(uint8_t *)arg); // squirrel_keyboard
+  keyboard_deactivate_keycode_ctx(ctx, arg); // squirrel_keyboard
   return ERR_NONE;
 }
 
-enum squirrel_error keyboard_modifier_press(uint8_t layer, uint8_t key_index,
-                                            void *arg) {
+enum squirrel_error keyboard_modifier_press(struct squirrel_ctx *ctx,
+                                            uint8_t layer,
+                                            squirrel_key_index_t key_index,
+                                            uint16_t arg) {
   (void)layer;
   (void)key_index;
-  keyboard_activate_modifier(*(uint8_t *)arg); // squirrel_keyboard
+  keyboard_activate_modifier_ctx(ctx, arg); // squirrel_keyboard
   return ERR_NONE;
 }
 
-enum squirrel_error keyboard_modifier_release(uint8_t layer, uint8_t key_index,
-                                              void *arg) {
+enum squirrel_error keyboard_modifier_release(struct squirrel_ctx *ctx,
+                                              uint8_t layer,
+                                              squirrel_key_index_t key_index,
+                                              uint16_t arg) {
   (void)layer;
   (void)key_index;
-  keyboard_deactivate_modifier(*(uint8_t *)arg); // squirrel_keyboard
+  keyboard_deactivate_modifier_ctx(ctx, arg); // squirrel_keyboard
   return ERR_NONE;
 }
 
-enum squirrel_error consumer_press(uint8_t layer, uint8_t key_index,
-                                   void *arg) {
+enum squirrel_error consumer_press(struct squirrel_ctx *ctx, uint8_t layer,
+                                   squirrel_key_index_t key_index,
+                                   uint16_t arg) {
   (void)layer;
   (void)key_index;
-  consumer_activate_consumer_code(*(uint16_t *)arg); // squirrel_consumer
+  consumer_activate_consumer_code_ctx(ctx, arg); // squirrel_consumer
   return ERR_NONE;
 }
 
-enum squirrel_error consumer_release(uint8_t layer, uint8_t key_index,
-                                     void *arg) {
+enum squirrel_error consumer_release(struct squirrel_ctx *ctx, uint8_t layer,
+                                     squirrel_key_index_t key_index,
+                                     uint16_t arg) {
   (void)layer;
   (void)key_index;
-  consumer_deactivate_consumer_code(*(uint16_t *)arg); // squirrel_consumer
+  consumer_deactivate_consumer_code_ctx(ctx, arg); // squirrel_consumer
   return ERR_NONE;
 }
 
+// passthrough_target returns the layer that a passthrough key on the given
+// layer passes to, or LAYER_NONE if there is none.
+static uint8_t passthrough_target(struct squirrel_ctx *ctx, uint8_t layer,
+                                  squirrel_key_index_t key_index) {
+  // The cached layer already skips every passthrough key above it.
+  uint8_t resolved = resolve_layer_ctx(ctx, key_index);
+  if (resolved < layer) {
+    return resolved;
+  }
+  squirrel_layer_mask_t below = ctx->active_layers & (LAYER_BIT(layer) - 1);
+  if (below == 0) {
+    return LAYER_NONE;
+  }
+  return highest_layer(below); // highest active layer below
+}
+
 // quantum_passthrough_press does not take extra arguments.
-enum squirrel_error quantum_passthrough_press(uint8_t layer, uint8_t key_index,
-                                              void *arg) {
+enum squirrel_error quantum_passthrough_press(struct squirrel_ctx *ctx,
+                                              uint8_t layer,
+                                              squirrel_key_index_t key_index,
+                                              uint16_t arg) {
   if (layer == 0) {
     return ERR_PASSTHROUGH_ON_BOTTOM_LAYER;
   };
-  for (int i = layer - 1; i >= 0; i--) {
-    if (!layers[i].active) {
-      continue;
-    }
-    struct key selected_key = layers[i].keys[key_index];
-    enum squirrel_error err =
-        selected_key.pressed(i, key_index, selected_key.pressed_argument);
-    if (err != ERR_NONE) {
-      return err;
-    }
-    if (i == 16) {
-      break;
-    }
-    copy_key(&selected_key, &layers[16].keys[key_index]);
-    break;
+  uint8_t i = passthrough_target(ctx, layer, key_index);
+  if (i == LAYER_NONE) {
+    return ERR_NONE;
+  }
+  struct key selected_key = layer_get_key_ctx(ctx, i, key_index);
+  enum squirrel_error err = dispatch_press_ctx(ctx, selected_key, i, key_index);
+  if (err != ERR_NONE) {
+    return err;
   }
+  hold_key(ctx, i, key_index);
   return ERR_NONE;
 }
 
 // quantum_passthrough_release does not take extra arguments.
-enum squirrel_error quantum_passthrough_release(uint8_t layer,
-                                                uint8_t key_index, void *arg) {
+enum squirrel_error quantum_passthrough_release(struct squirrel_ctx *ctx,
+                                                uint8_t layer,
+                                                squirrel_key_index_t key_index,
+                                                uint16_t arg) {
   if (layer == 0) {
     return ERR_PASSTHROUGH_ON_BOTTOM_LAYER;
   };
-  for (int i = layer - 1; i >= 0; i--) {
-    if (!layers[i].active) {
-      continue;
+  uint8_t i = passthrough_target(ctx, layer, key_index);
+  if (i == LAYER_NONE) {
+    return ERR_NONE;
+  }
+  return dispatch_release_ctx(ctx, layer_get_key_ctx(ctx, i, key_index), i,
+                              key_index);
+}
+
+enum squirrel_error layer_momentary_press(struct squirrel_ctx *ctx,
+                                          uint8_t layer,
+                                          squirrel_key_index_t key_index,
+                                          uint16_t arg) {
+  uint8_t target_layer = arg;
+  layer_set_active_ctx(ctx, target_layer, true);
+  return ERR_NONE;
+}
+
+enum squirrel_error layer_momentary_release(struct squirrel_ctx *ctx,
+                                            uint8_t layer,
+                                            squirrel_key_index_t key_index,
+                                            uint16_t arg) {
+  uint8_t target_layer = arg;
+  layer_set_active_ctx(ctx, target_layer, false);
+  return ERR_NONE;
+}
+
+enum squirrel_error layer_toggle_press(struct squirrel_ctx *ctx, uint8_t layer,
+                                       squirrel_key_index_t key_index,
+                                       uint16_t arg) {
+  uint8_t target_layer = arg;
+  layer_set_active_mask_ctx(ctx, ctx->active_layers ^ LAYER_BIT(target_layer));
+  return ERR_NONE;
+}
+
+enum squirrel_error layer_toggle_release(struct squirrel_ctx *ctx,
+                                         uint8_t layer,
+                                         squirrel_key_index_t key_index,
+                                         uint16_t arg) {
+  return ERR_NONE;
+}
+
+enum squirrel_error layer_solo_press(struct squirrel_ctx *ctx, uint8_t layer,
+                                     squirrel_key_index_t key_index,
+                                     uint16_t arg) {
+  uint8_t target_layer = arg;
+  layer_set_active_mask_ctx(ctx, LAYER_BIT(target_layer));
+  return ERR_NONE;
+}
+
+enum squirrel_error layer_solo_release(struct squirrel_ctx *ctx, uint8_t layer,
+                                       squirrel_key_index_t key_index,
+                                       uint16_t arg) {
+  return ERR_NONE;
+}
+
+void tap_hold_set_mode_ctx(struct squirrel_ctx *ctx, enum tap_hold_mode mode,
+                           uint16_t term) {
+  ctx->tap_hold.mode = mode;
+  ctx->tap_hold.term = term;
+}
+void tap_hold_set_mode(enum tap_hold_mode mode, uint16_t term) {
+  tap_hold_set_mode_ctx(&squirrel_default_ctx, mode, term);
+}
+
+// tap_hold_decide settles the undecided tap-hold key as a tap or a hold, then
+// replays the key events that were held back while it was undecided.
+static enum squirrel_error tap_hold_decide(struct squirrel_ctx *ctx,
+                                           bool tap) {
+  struct tap_hold_state *th = &ctx->tap_hold;
+  th->pending = false;
+  timer_cancel_ctx(ctx, th->timer);
+  th->timer = TIMER_NONE;
+  uint8_t keycode = th->key.argument & 0xFF;
+  uint8_t hold = th->key.argument >> 8;
+  if (tap) {
+    th->tapped[th->key_index / 32] |= 1u << (th->key_index % 32);
+    keyboard_activate_keycode_ctx(ctx, keycode);
+  } else if (th->key.action == ACTION_MOD_TAP) {
+    keyboard_activate_modifier_ctx(ctx, hold);
+  } else {
+    layer_set_active_ctx(ctx, hold, true);
+  }
+  // Replay from a copy, as a replayed tap-hold key can hold back the events
+  // after it in turn.
+  struct tap_hold_event events[SQUIRREL_TAP_HOLD_BUFFER_SIZE];
+  uint8_t count = th->buffered;
+  memcpy(events, th->buffer, count * sizeof(events[0]));
+  th->buffered = 0;
+  for (uint8_t i = 0; i < count; i++) {
+    enum squirrel_error err;
+    if (events[i].resolved) {
+      err = tap_hold_dispatch(ctx, events[i].key, events[i].key_index,
+                              events[i].pressed);
+    } else {
+      err = key_event_stage_ctx(ctx, events[i].key_index, events[i].pressed,
+                                KEY_STAGE_TAP_HOLD);
     }
-    struct key selected_key = layers[i].keys[key_index];
-    enum squirrel_error err =
-        selected_key.released(i, key_index, selected_key.released_argument);
     if (err != ERR_NONE) {
       return err;
     }
-    if (i != 16) {
-      break;
-    }
-    struct key passthrough_key;
-    passthrough_key.pressed = quantum_passthrough_press;
-    passthrough_key.released = quantum_passthrough_release;
-    copy_key(&passthrough_key, &layers[16].keys[key_index]);
-    break;
   }
   return ERR_NONE;
 }
 
-enum squirrel_error layer_momentary_press(uint8_t layer, uint8_t key_index,
-                                          void *arg) {
-  uint8_t target_layer = *(uint8_t *)arg;
-  layers[target_layer].active = true;
-  return ERR_NONE;
+// tap_hold_timeout is called once the tapping term of a tap-hold key passes.
+static enum squirrel_error tap_hold_timeout(struct squirrel_ctx *ctx,
+                                            uint16_t arg) {
+  (void)arg;
+  ctx->tap_hold.timer = TIMER_NONE; // it just expired
+  if (!ctx->tap_hold.pending) {
+    return ERR_NONE;
+  }
+  return tap_hold_decide(ctx, false);
 }
 
-enum squirrel_error layer_momentary_release(uint8_t layer, uint8_t key_index,
-                                            void *arg) {
-  uint8_t target_layer = *(uint8_t *)arg;
-  layers[target_layer].active = false;
+// was_pressed_while_pending returns true if the key was pressed after the
+// undecided tap-hold key.
+static bool was_pressed_while_pending(const struct tap_hold_state *th,
+                                      squirrel_key_index_t key_index) {
+  for (uint8_t i = 0; i < th->buffered; i++) {
+    if (th->buffer[i].key_index == key_index && th->buffer[i].pressed) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// intercept holds the event back, or lets it decide the undecided tap-hold
+// key, as described for tap_hold_intercept.
+static enum squirrel_error intercept(struct squirrel_ctx *ctx,
+                                     struct tap_hold_event event,
+                                     bool *buffered) {
+  struct tap_hold_state *th = &ctx->tap_hold;
+  *buffered = false;
+  // Deciding the key replays the held back events, which can leave another
+  // tap-hold key undecided. The event then has to wait behind that key's
+  // events in turn, so it goes through again for as long as one is pending.
+  while (th->pending) {
+    enum squirrel_error err;
+    if (!event.resolved && event.key_index == th->key_index) {
+      // Released before the key was decided, so it is a tap. The release
+      // itself goes on as usual.
+      err = tap_hold_decide(ctx, true);
+    } else if (th->buffered == SQUIRREL_TAP_HOLD_BUFFER_SIZE) {
+      // No room to wait any longer.
+      err = tap_hold_decide(ctx, false);
+    } else {
+      bool decides_hold =
+          (th->mode == TAP_HOLD_ON_OTHER_KEY_PRESS && event.pressed) ||
+          (th->mode == TAP_HOLD_PERMISSIVE_HOLD && !event.pressed &&
+           was_pressed_while_pending(th, event.key_index));
+      th->buffer[th->buffered++] = event;
+      *buffered = true;
+      if (decides_hold) {
+        return tap_hold_decide(ctx, false);
+      }
+      return ERR_NONE;
+    }
+    if (err != ERR_NONE) {
+      return err;
+    }
+  }
   return ERR_NONE;
 }
 
-enum squirrel_error layer_toggle_press(uint8_t layer, uint8_t key_index,
-                                       void *arg) {
-  uint8_t target_layer = *(uint8_t *)arg;
-  layers[target_layer].active = !layers[target_layer].active;
+enum squirrel_error tap_hold_intercept(struct squirrel_ctx *ctx,
+                                       squirrel_key_index_t key_index,
+                                       bool pressed, bool *buffered) {
+  return intercept(
+      ctx, (struct tap_hold_event){.key_index = key_index, .pressed = pressed},
+      buffered);
+}
+
+enum squirrel_error tap_hold_dispatch(struct squirrel_ctx *ctx, struct key key,
+                                      squirrel_key_index_t key_index,
+                                      bool pressed) {
+  if (ctx->tap_hold.pending) {
+    bool buffered;
+    enum squirrel_error err =
+        intercept(ctx,
+                  (struct tap_hold_event){.key_index = key_index,
+                                          .pressed = pressed,
+                                          .resolved = true,
+                                          .key = key},
+                  &buffered);
+    if (err != ERR_NONE || buffered) {
+      return err;
+    }
+  }
+  if (pressed) {
+    return dispatch_press_ctx(ctx, key, 0, key_index);
+  }
+  return dispatch_release_ctx(ctx, key, 0, key_index);
+}
+
+// tap_hold_press makes the key at the index the undecided tap-hold key.
+static enum squirrel_error tap_hold_press(struct squirrel_ctx *ctx,
+                                          uint16_t action,
+                                          squirrel_key_index_t key_index,
+                                          uint16_t arg) {
+  struct tap_hold_state *th = &ctx->tap_hold;
+  th->pending = true;
+  th->key_index = key_index;
+  th->key = (struct key){.action = action, .argument = arg};
+  th->buffered = 0;
+  // Without a free timer, the key can still be decided by other keys.
+  uint16_t term = th->term != 0 ? th->term : SQUIRREL_TAPPING_TERM;
+  th->timer = timer_start_ctx(ctx, term, tap_hold_timeout, 0);
   return ERR_NONE;
 }
 
-enum squirrel_error layer_toggle_release(uint8_t layer, uint8_t key_index,
-                                         void *arg) {
+// tap_hold_tapped returns true, and forgets it, if the key at the index was
+// decided as a tap. A key released while it is still undecided, which only
+// happens when its key changes while it is held, is decided as a tap first.
+static bool tap_hold_tapped(struct squirrel_ctx *ctx,
+                            squirrel_key_index_t key_index) {
+  if (ctx->tap_hold.pending && ctx->tap_hold.key_index == key_index) {
+    tap_hold_decide(ctx, true);
+  }
+  uint32_t bit = 1u << (key_index % 32);
+  uint32_t *word = &ctx->tap_hold.tapped[key_index / 32];
+  bool tapped = *word & bit;
+  *word &= ~bit;
+  return tapped;
+}
+
+// tap_released is called a tick after a tap-hold key was tapped, to release
+// its keycode.
+static enum squirrel_error tap_released(struct squirrel_ctx *ctx,
+                                        uint16_t keycode) {
+  keyboard_deactivate_keycode_ctx(ctx, keycode);
   return ERR_NONE;
 }
 
-enum squirrel_error layer_solo_press(uint8_t layer, uint8_t key_index,
-                                     void *arg) {
-  uint8_t target_layer = *(uint8_t *)arg;
-  for (uint8_t i = 0; i < 16; i++) {
-    layers[i].active = false;
+// release_tap releases the keycode of a tap-hold key that was tapped. A tap is
+// only decided when the key is released, so the keycode was pressed by the
+// same release. Its release waits for the next tick, so that a host reading
+// the report in between sees it.
+static void release_tap(struct squirrel_ctx *ctx, uint8_t keycode) {
+  if (timer_start_ctx(ctx, 1, tap_released, keycode) == TIMER_NONE) {
+    keyboard_deactivate_keycode_ctx(ctx, keycode); // better than stuck
   }
-  layers[target_layer].active = true;
+}
+
+enum squirrel_error mod_tap_press(struct squirrel_ctx *ctx, uint8_t layer,
+                                  squirrel_key_index_t key_index,
+                                  uint16_t arg) {
+  (void)layer;
+  return tap_hold_press(ctx, ACTION_MOD_TAP, key_index, arg);
+}
+
+enum squirrel_error mod_tap_release(struct squirrel_ctx *ctx, uint8_t layer,
+                                    squirrel_key_index_t key_index,
+                                    uint16_t arg) {
+  (void)layer;
+  if (tap_hold_tapped(ctx, key_index)) {
+    release_tap(ctx, arg & 0xFF);
+    return ERR_NONE;
+  }
+  keyboard_deactivate_modifier_ctx(ctx, arg >> 8);
   return ERR_NONE;
 }
 
-enum squirrel_error layer_solo_release(uint8_t layer, uint8_t key_index,
-                                       void *arg) {
+enum squirrel_error layer_tap_press(struct squirrel_ctx *ctx, uint8_t layer,
+                                    squirrel_key_index_t key_index,
+                                    uint16_t arg) {
+  (void)layer;
+  return tap_hold_press(ctx, ACTION_LAYER_TAP, key_index, arg);
+}
+
+enum squirrel_error layer_tap_release(struct squirrel_ctx *ctx, uint8_t layer,
+                                      squirrel_key_index_t key_index,
+                                      uint16_t arg) {
+  (void)layer;
+  if (tap_hold_tapped(ctx, key_index)) {
+    release_tap(ctx, arg & 0xFF);
+    return ERR_NONE;
+  }
+  layer_set_active_ctx(ctx, arg >> 8, false);
   return ERR_NONE;
 }
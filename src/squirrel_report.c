@@ -0,0 +1,177 @@
+#include "squirrel_report.h"
+#include "squirrel_ctx.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+void squirrel_report_mark_changed_ctx(struct squirrel_ctx *ctx,
+                                      enum report_type type) {
+  ctx->report.generations[type]++;
+  ctx->report.changed |= REPORT_CHANGED(type);
+}
+void squirrel_report_mark_changed(enum report_type type) {
+  squirrel_report_mark_changed_ctx(&squirrel_default_ctx, type);
+}
+void squirrel_report_transition_ctx(struct squirrel_ctx *ctx,
+                                    enum report_type type, uint16_t code,
+                                    bool pressed) {
+  squirrel_report_mark_changed_ctx(ctx, type);
+  struct report_frames *frames = &ctx->report.frames;
+  if (!frames->enabled || frames->overflowed) {
+    return;
+  }
+  if (frames->queued == SQUIRREL_REPORT_QUEUE_SIZE) {
+    frames->overflowed = true;
+    return;
+  }
+  uint8_t tail = (frames->head + frames->queued) % SQUIRREL_REPORT_QUEUE_SIZE;
+  frames->queue[tail] = (struct report_transition){
+      .type = type, .pressed = pressed, .code = code};
+  frames->queued++;
+}
+void squirrel_report_transition(enum report_type type, uint16_t code,
+                                bool pressed) {
+  squirrel_report_transition_ctx(&squirrel_default_ctx, type, code, pressed);
+}
+uint32_t squirrel_report_generation_ctx(struct squirrel_ctx *ctx,
+                                        enum report_type type) {
+  return ctx->report.generations[type];
+}
+uint32_t squirrel_report_generation(enum report_type type) {
+  return squirrel_report_generation_ctx(&squirrel_default_ctx, type);
+}
+uint8_t squirrel_report_changed_ctx(struct squirrel_ctx *ctx) {
+  uint8_t result = ctx->report.changed;
+  ctx->report.changed = 0;
+  return result;
+}
+uint8_t squirrel_report_changed(void) {
+  return squirrel_report_changed_ctx(&squirrel_default_ctx);
+}
+
+void squirrel_report_publish_ctx(struct squirrel_ctx *ctx) {
+  struct report_state *state = &ctx->report;
+  uint_fast32_t n =
+      atomic_load_explicit(&state->sequence, memory_order_relaxed);
+  // Readers of snapshot n - 1 must see sequence n before any of the writes
+  // that overwrite their buffer.
+  atomic_thread_fence(memory_order_release);
+  struct squirrel_report_snapshot *snapshot = &state->snapshots[(n + 1) % 2];
+  memcpy(&snapshot->keyboard, &ctx->keyboard_report,
+         sizeof(snapshot->keyboard));
+  snapshot->consumer_code = ctx->consumer_code;
+  atomic_store_explicit(&state->sequence, n + 1, memory_order_release);
+}
+void squirrel_report_publish(void) {
+  squirrel_report_publish_ctx(&squirrel_default_ctx);
+}
+
+uint32_t squirrel_report_read_ctx(struct squirrel_ctx *ctx,
+                                  struct squirrel_report_snapshot *snapshot) {
+  struct report_state *state = &ctx->report;
+  for (;;) {
+    uint_fast32_t n =
+        atomic_load_explicit(&state->sequence, memory_order_acquire);
+    memcpy(snapshot, &state->snapshots[n % 2], sizeof(*snapshot));
+    // The copy must be finished before sequence is checked again.
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&state->sequence, memory_order_relaxed) == n) {
+      return n;
+    }
+  }
+}
+uint32_t squirrel_report_read(struct squirrel_report_snapshot *snapshot) {
+  return squirrel_report_read_ctx(&squirrel_default_ctx, snapshot);
+}
+
+void squirrel_report_frame_enable_ctx(struct squirrel_ctx *ctx, bool enabled) {
+  struct report_frames *frames = &ctx->report.frames;
+  frames->enabled = enabled;
+  frames->head = 0;
+  frames->queued = 0;
+  // Resync on the next frame, as changes may have been missed.
+  frames->overflowed = true;
+}
+void squirrel_report_frame_enable(bool enabled) {
+  squirrel_report_frame_enable_ctx(&squirrel_default_ctx, enabled);
+}
+
+// frame_sync makes the current state the next report, and returns true if it
+// differs from the last one.
+static bool frame_sync(struct squirrel_ctx *ctx) {
+  struct report_frames *frames = &ctx->report.frames;
+  struct squirrel_report_snapshot current = {.consumer_code =
+                                                 ctx->consumer_code};
+  memcpy(&current.keyboard, &ctx->keyboard_report, sizeof(current.keyboard));
+  bool changed = memcmp(&current.keyboard, &frames->sent.keyboard,
+                        sizeof(current.keyboard)) != 0 ||
+                 current.consumer_code != frames->sent.consumer_code;
+  frames->sent = current;
+  frames->head = 0;
+  frames->queued = 0;
+  frames->overflowed = false;
+  return changed;
+}
+
+// frame_apply applies the recorded changes to sent in order, until one
+// changes a keycode, modifier or consumer code that already changed in this
+// frame, and returns true if any was applied. A host reads a report as if its
+// keycode releases came first, then its modifier changes, then its keycode
+// presses, so a change that would be read out of order ends the frame too.
+static bool frame_apply(struct report_frames *frames) {
+  uint8_t keycodes[sizeof(frames->sent.keyboard.keycodes)] = {0};
+  uint8_t modifiers = 0;
+  bool keycode_pressed = false;
+  bool consumer = false;
+  bool changed = false;
+  for (; frames->queued > 0; frames->queued--) {
+    const struct report_transition *t = &frames->queue[frames->head];
+    struct keyboard_nkro_report *sent = &frames->sent.keyboard;
+    if (t->type == REPORT_KEYBOARD) {
+      uint8_t bit = 1u << (t->code % 8);
+      if ((keycodes[t->code / 8] & bit) || (!t->pressed && modifiers != 0)) {
+        break;
+      }
+      keycodes[t->code / 8] |= bit;
+      if (t->pressed) {
+        keycode_pressed = true;
+        sent->keycodes[t->code / 8] |= bit;
+      } else {
+        sent->keycodes[t->code / 8] &= ~bit;
+      }
+    } else if (t->type == REPORT_MODIFIERS) {
+      if ((modifiers & t->code) || keycode_pressed) {
+        break;
+      }
+      modifiers |= t->code;
+      if (t->pressed) {
+        sent->modifiers |= t->code;
+      } else {
+        sent->modifiers &= ~t->code;
+      }
+    } else {
+      if (consumer) {
+        break;
+      }
+      consumer = true;
+      frames->sent.consumer_code = t->code;
+    }
+    frames->head = (frames->head + 1) % SQUIRREL_REPORT_QUEUE_SIZE;
+    changed = true;
+  }
+  return changed;
+}
+
+bool squirrel_report_frame_ctx(struct squirrel_ctx *ctx,
+                               struct squirrel_report_snapshot *report) {
+  struct report_frames *frames = &ctx->report.frames;
+  bool changed = !frames->enabled || frames->overflowed
+                     ? frame_sync(ctx)
+                     : frame_apply(frames);
+  *report = frames->sent;
+  return changed;
+}
+bool squirrel_report_frame(struct squirrel_report_snapshot *report) {
+  return squirrel_report_frame_ctx(&squirrel_default_ctx, report);
+}
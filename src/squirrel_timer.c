@@ -0,0 +1,161 @@
+#include "squirrel_timer.h"
+#include "squirrel.h"
+#include "squirrel_ctx.h"
+#include <stdint.h>
+
+#if SQUIRREL_TIMER_CAPACITY > 254
+#error "SQUIRREL_TIMER_CAPACITY must be at most 254"
+#endif
+
+// timer_at returns the timer with the given number, counting from 1.
+static struct timer *timer_at(struct timer_wheel *wheel, uint8_t timer) {
+  return &wheel->timers[timer - 1];
+}
+
+// wheel_insert puts a timer in the slot its deadline falls in, measured from
+// base: level 0 for the next TIMER_SLOTS ticks, and coarser levels further
+// away. Timers on coarser levels are moved down as their slot comes up.
+static void wheel_insert(struct timer_wheel *wheel, uint8_t timer,
+                         uint32_t base) {
+  struct timer *t = timer_at(wheel, timer);
+  uint32_t delta = t->deadline - base;
+  uint8_t level = 0;
+  while (level < TIMER_LEVELS - 1 &&
+         delta >= (1u << (TIMER_SLOT_BITS * (level + 1)))) {
+    level++;
+  }
+  uint8_t slot =
+      (t->deadline >> (TIMER_SLOT_BITS * level)) & (TIMER_SLOTS - 1);
+  uint8_t *head = &wheel->slots[level][slot];
+  t->slot = level * TIMER_SLOTS + slot;
+  t->previous = TIMER_NONE;
+  t->next = *head;
+  if (*head != TIMER_NONE) {
+    timer_at(wheel, *head)->previous = timer;
+  }
+  *head = timer;
+}
+
+// wheel_remove takes a timer out of its slot, or out of the expiring list.
+static void wheel_remove(struct timer_wheel *wheel, uint8_t timer) {
+  struct timer *t = timer_at(wheel, timer);
+  if (t->previous != TIMER_NONE) {
+    timer_at(wheel, t->previous)->next = t->next;
+  } else if (t->slot == TIMER_EXPIRING) {
+    wheel->expiring = t->next;
+  } else {
+    wheel->slots[t->slot / TIMER_SLOTS][t->slot % TIMER_SLOTS] = t->next;
+  }
+  if (t->next != TIMER_NONE) {
+    timer_at(wheel, t->next)->previous = t->previous;
+  }
+}
+
+// wheel_free returns a timer to the free list.
+static void wheel_free(struct timer_wheel *wheel, uint8_t timer) {
+  timer_at(wheel, timer)->next = wheel->free;
+  wheel->free = timer;
+  wheel->pending--;
+}
+
+uint8_t timer_start_ctx(struct squirrel_ctx *ctx, uint16_t delay,
+                        timer_func func, uint16_t arg) {
+  struct timer_wheel *wheel = &ctx->timers;
+  uint8_t timer;
+  if (wheel->free != TIMER_NONE) {
+    timer = wheel->free;
+    wheel->free = timer_at(wheel, timer)->next;
+  } else if (wheel->used < SQUIRREL_TIMER_CAPACITY) {
+    timer = ++wheel->used;
+  } else {
+    return TIMER_NONE;
+  }
+  if (delay == 0) {
+    delay = 1;
+  }
+  if (delay > TIMER_MAX_DELAY) {
+    delay = TIMER_MAX_DELAY;
+  }
+  struct timer *t = timer_at(wheel, timer);
+  t->deadline = wheel->now + delay;
+  t->func = func;
+  t->arg = arg;
+  wheel_insert(wheel, timer, wheel->now);
+  wheel->pending++;
+  return timer;
+}
+uint8_t timer_start(uint16_t delay, timer_func func, uint16_t arg) {
+  return timer_start_ctx(&squirrel_default_ctx, delay, func, arg);
+}
+
+void timer_cancel_ctx(struct squirrel_ctx *ctx, uint8_t timer) {
+  if (timer == TIMER_NONE) {
+    return;
+  }
+  wheel_remove(&ctx->timers, timer);
+  wheel_free(&ctx->timers, timer);
+}
+void timer_cancel(uint8_t timer) {
+  timer_cancel_ctx(&squirrel_default_ctx, timer);
+}
+
+uint32_t squirrel_now_ctx(struct squirrel_ctx *ctx) { return ctx->timers.now; }
+uint32_t squirrel_now(void) { return squirrel_now_ctx(&squirrel_default_ctx); }
+
+// cascade moves the timers of a slot on a coarser level down to the levels
+// below, now that the slot's range of ticks has started at tick.
+static void cascade(struct timer_wheel *wheel, uint8_t level, uint32_t tick) {
+  uint8_t slot = (tick >> (TIMER_SLOT_BITS * level)) & (TIMER_SLOTS - 1);
+  uint8_t timer = wheel->slots[level][slot];
+  wheel->slots[level][slot] = TIMER_NONE;
+  while (timer != TIMER_NONE) {
+    uint8_t next = timer_at(wheel, timer)->next;
+    wheel_insert(wheel, timer, tick);
+    timer = next;
+  }
+}
+
+enum squirrel_error squirrel_tick_ctx(struct squirrel_ctx *ctx, uint32_t now) {
+  struct timer_wheel *wheel = &ctx->timers;
+  enum squirrel_error result = ERR_NONE;
+  while (wheel->now != now) {
+    if (wheel->pending == 0) {
+      wheel->now = now; // nothing can expire, so skip ahead
+      break;
+    }
+    uint32_t tick = wheel->now + 1;
+    // Coarse slots are moved down when their range starts, highest first.
+    for (uint8_t level = TIMER_LEVELS - 1; level > 0; level--) {
+      if ((tick & ((1u << (TIMER_SLOT_BITS * level)) - 1)) == 0) {
+        cascade(wheel, level, tick);
+      }
+    }
+    wheel->now = tick;
+    // Every timer left in this level 0 slot expires now. Move them all to the
+    // expiring list first, so that the functions can start new timers, and
+    // cancel the timers that have not run yet.
+    uint8_t *head = &wheel->slots[0][tick & (TIMER_SLOTS - 1)];
+    wheel->expiring = *head;
+    *head = TIMER_NONE;
+    for (uint8_t timer = wheel->expiring; timer != TIMER_NONE;
+         timer = timer_at(wheel, timer)->next) {
+      timer_at(wheel, timer)->slot = TIMER_EXPIRING;
+    }
+    while (wheel->expiring != TIMER_NONE) {
+      uint8_t timer = wheel->expiring;
+      struct timer *t = timer_at(wheel, timer);
+      timer_func func = t->func;
+      uint16_t arg = t->arg;
+      wheel_remove(wheel, timer);
+      wheel_free(wheel, timer);
+      enum squirrel_error err = func(ctx, arg);
+      if (err != ERR_NONE && result == ERR_NONE) {
+        result = err;
+      }
+    }
+  }
+  return result;
+}
+enum squirrel_error squirrel_tick(uint32_t now) {
+  return squirrel_tick_ctx(&squirrel_default_ctx, now);
+}
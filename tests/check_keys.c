@@ -0,0 +1,121 @@
+#include "squirrel.h"
+#include "squirrel_ctx.h"
+#include "squirrel_init.h"
+#include "squirrel_key.h"
+#include "squirrel_keymap.h"
+#include "squirrel_quantum.h"
+#include <stdint.h>
+#include <stdlib.h>
+
+uint8_t presses = 0;
+uint8_t releases = 0;
+
+enum squirrel_error test_press(struct squirrel_ctx *ctx, uint8_t layer,
+                               uint8_t key_index, uint16_t arg) {
+  (void)ctx;
+  (void)layer;
+  (void)key_index;
+  (void)arg;
+  presses++;
+  return ERR_NONE;
+}
+
+enum squirrel_error test_release(struct squirrel_ctx *ctx, uint8_t layer,
+                                 uint8_t key_index, uint16_t arg) {
+  (void)ctx;
+  (void)layer;
+  (void)key_index;
+  (void)arg;
+  releases++;
+  return ERR_NONE;
+}
+
+// test: check_keys - in squirrel_key.c
+int main() {
+  squirrel_init();
+
+  custom_actions[0] = (struct action){test_press, test_release};
+  layer_set_key(0, 0, custom(0, 0));
+  layer_set_active(0, true);
+
+  uint32_t bitmap[SQUIRREL_KEYSTATE_WORDS] = {0};
+
+  // nothing pressed, nothing changes
+  enum squirrel_error err = check_keys(bitmap);
+  if (err != ERR_NONE) {
+    return 1;
+  }
+  if (presses != 0 || releases != 0) {
+    return 2;
+  }
+
+  // pressing the key should call press_key once
+  bitmap[0] = 1;
+  err = check_keys(bitmap);
+  if (err != ERR_NONE) {
+    return 3;
+  }
+  if (presses != 1 || releases != 0) {
+    return 4;
+  }
+  if (squirrel_default_ctx.key_states[0] != 1) {
+    return 5;
+  }
+
+  // the same scan again should not call anything
+  err = check_keys(bitmap);
+  if (err != ERR_NONE) {
+    return 6;
+  }
+  if (presses != 1 || releases != 0) {
+    return 7;
+  }
+
+  // releasing the key should call release_key once
+  bitmap[0] = 0;
+  err = check_keys(bitmap);
+  if (err != ERR_NONE) {
+    return 8;
+  }
+  if (presses != 1 || releases != 1) {
+    return 9;
+  }
+  if (squirrel_default_ctx.key_states[0] != 0) {
+    return 10;
+  }
+
+  // bits past SQUIRREL_KEYCOUNT are ignored
+  bitmap[SQUIRREL_KEYSTATE_WORDS - 1] = ~(uint32_t)0 << (SQUIRREL_KEYCOUNT % 32);
+  err = check_keys(bitmap);
+  if (err != ERR_NONE) {
+    return 11;
+  }
+  if (presses != 1 || releases != 1) {
+    return 12;
+  }
+
+  // keys in every word are visited, and the unused bits stay ignored
+  int last = SQUIRREL_KEYCOUNT - 1;
+  layer_set_key(0, last, custom(0, 0));
+  bitmap[0] = 1;
+  bitmap[last / 32] |= 1u << (last % 32);
+  err = check_keys(bitmap);
+  if (err != ERR_NONE) {
+    return 13;
+  }
+  if (presses != 3 || releases != 1) {
+    return 14;
+  }
+  if (squirrel_default_ctx.key_states[last / 32] !=
+      (last / 32 == 0 ? 1u : 0u) + (1u << (last % 32))) {
+    return 15;
+  }
+  for (int w = 0; w < SQUIRREL_KEYSTATE_WORDS; w++) {
+    bitmap[w] = 0;
+  }
+  err = check_keys(bitmap);
+  if (err != ERR_NONE || presses != 3 || releases != 3) {
+    return 16;
+  }
+  return 0;
+}
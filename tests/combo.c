@@ -0,0 +1,221 @@
+#include "scenario.h"
+#include "squirrel_combo.h"
+#include "squirrel_ctx.h"
+#include "squirrel_keymap.h"
+#include "squirrel_quantum.h"
+#include <stdint.h>
+
+// Keys 1+2 and 1+2+3 share their lowest key, keys 31+33 are in different
+// words, and keys 4+5 are another combo. Each combo records its own argument.
+static const struct combo combos[] = {
+    {{(1u << 1) | (1u << 2)}, KEY_CUSTOM(0, 0)},
+    {{(1u << 1) | (1u << 2) | (1u << 3)}, KEY_CUSTOM(0, 1)},
+    {{1u << 31, 1u << 1}, KEY_CUSTOM(0, 2)},
+    {{(1u << 4) | (1u << 5)}, KEY_CUSTOM(0, 3)},
+};
+#define COMBO_COUNT (sizeof(combos) / sizeof(combos[0]))
+
+// Keys 0+1 and 2+3, for a tap-hold key that is also in a combo.
+static const struct combo pairs[] = {
+    {{(1u << 0) | (1u << 1)}, KEY_CUSTOM(0, 4)},
+    {{(1u << 2) | (1u << 3)}, KEY_CUSTOM(0, 5)},
+};
+
+// Every key types its own keycode when it is not part of a combo.
+static struct key base[SQUIRREL_KEYCOUNT];
+#define KEYCODE(key_index) (A + (key_index))
+
+// reset starts a scenario with nothing pressed.
+void reset(void) {
+  scenario_start();
+  layer_set_keymap(0, base);
+  layer_set_active(0, true);
+  combo_set_table(combos, COMBO_COUNT);
+}
+
+// typed returns true if the keycode of the key at the index is active.
+bool typed(squirrel_key_index_t key_index) {
+  return keyboard_get_keycode(KEYCODE(key_index));
+}
+
+// test: combo_set_table + combo_intercept - in squirrel_combo.c
+int main() {
+  for (int i = 0; i < SQUIRREL_KEYCOUNT; i++) {
+    base[i] = keyboard(KEYCODE(i));
+  }
+  custom_actions[0] = (struct action){record_press, record_release};
+
+  // a combo completes at once if no longer combo shares its lowest key, even
+  // across words
+  reset();
+  if (!key(31, true, 5) || presses != 0 || typed(31)) {
+    return 1; // held back
+  }
+  if (!key(33, true, 0) || presses != 1 || seen_arg != 2 ||
+      seen_key_index != 31 || typed(31) || typed(33)) {
+    return 2;
+  }
+  // the first release releases the combo, and the other is swallowed
+  if (!key(33, false, 0) || releases != 1 || !key(31, false, 0) ||
+      releases != 1 || typed(31)) {
+    return 3;
+  }
+
+  // a combo waits while a longer one could still complete
+  reset();
+  if (!key(1, true, 5) || !key(2, true, 5) || presses != 0) {
+    return 4;
+  }
+  if (!key(3, true, 0) || presses != 1 || seen_arg != 1) {
+    return 5;
+  }
+  if (!key(2, false, 0) || !key(1, false, 0) || !key(3, false, 0) ||
+      releases != 1 || typed(1) || typed(2) || typed(3)) {
+    return 6;
+  }
+
+  // and completes when the term passes
+  reset();
+  if (!key(1, true, 5) || !key(2, true, SQUIRREL_COMBO_TERM) ||
+      presses != 1 || seen_arg != 0) {
+    return 7;
+  }
+  key(1, false, 0);
+  key(2, false, 0);
+
+  // or when one of its keys is released
+  reset();
+  if (!key(1, true, 5) || !key(2, true, 5) || !key(1, false, 0)) {
+    return 8;
+  }
+  if (presses != 1 || seen_arg != 0 || releases != 1) {
+    return 9;
+  }
+  if (!key(2, false, 0) || releases != 1 || typed(2)) {
+    return 10;
+  }
+
+  // a lone combo key is typed once the term passes
+  reset();
+  if (!key(4, true, SQUIRREL_COMBO_TERM - 1) || typed(4)) {
+    return 11;
+  }
+  if (!key(4, false, 0) || typed(4)) {
+    return 12; // the release lets the press go first
+  }
+  if (!key(4, true, SQUIRREL_COMBO_TERM) || !typed(4) || presses != 0) {
+    return 13;
+  }
+  key(4, false, 0);
+
+  // pressing a key that is in no combo lets the held back keys go first
+  reset();
+  if (!key(4, true, 5) || !key(10, true, 0) || !typed(4) || !typed(10)) {
+    return 14;
+  }
+  key(4, false, 0);
+  key(10, false, 0);
+
+  // keys that are in no combo together go on, but the newest can still start
+  // one
+  reset();
+  if (!key(4, true, 5) || !key(2, true, 5) || !typed(4) || typed(2)) {
+    return 15;
+  }
+  if (!key(1, true, SQUIRREL_COMBO_TERM) || presses != 1 || seen_arg != 0) {
+    return 16;
+  }
+  if (!key(4, false, 0) || typed(4) || releases != 0) {
+    return 17;
+  }
+
+  // keys that are not in any combo are never held back
+  reset();
+  if (!key(10, true, 0) || !typed(10) || !key(10, false, 0) || typed(10)) {
+    return 18;
+  }
+
+  // invalid tables are refused, and leave combos off
+  struct combo single = {{1u << 1}, KEY_CUSTOM(0, 0)};
+  if (combo_set_table(&single, 1) != ERR_COMBO_TABLE_INVALID) {
+    return 19;
+  }
+  if (combo_set_table(combos, SQUIRREL_COMBO_CAPACITY + 1) !=
+      ERR_COMBO_TABLE_INVALID) {
+    return 20;
+  }
+  if (!key(1, true, 0) || !typed(1)) {
+    return 21;
+  }
+  key(1, false, 0);
+
+  // combos can be built at runtime, and the term can be changed
+  reset();
+  struct combo built = {{0}, KEY_CUSTOM(0, 7)};
+  combo_add_key(&built, 39);
+  combo_add_key(&built, 0);
+  if (combo_set_table(&built, 1) != ERR_NONE) {
+    return 22;
+  }
+  combo_set_term(10);
+  if (!key(39, true, 10) || !typed(39)) {
+    return 23;
+  }
+  if (!key(0, true, 0) || !key(0, false, 0) || !key(39, false, 0) ||
+      typed(0) || typed(39) || presses != 0) {
+    return 24;
+  }
+  if (!key(39, true, 5) || !key(0, true, 0) || presses != 1 ||
+      seen_arg != 7 || seen_key_index != 0) {
+    return 25;
+  }
+
+  // a tap-hold key that is in a combo can be decided by a key of another
+  // combo, as both their timers expire in the same tick
+  reset();
+  layer_set_key(0, 0, mod_tap(SHIFT, KEYCODE(0)));
+  combo_set_table(pairs, 2);
+  combo_set_term(SQUIRREL_TAPPING_TERM);
+  tap_hold_set_mode(TAP_HOLD_ON_OTHER_KEY_PRESS, 0);
+  if (!key(0, true, 0) || !key(2, true, SQUIRREL_TAPPING_TERM) ||
+      keyboard_get_modifiers() != SHIFT || !typed(2) || presses != 0) {
+    return 26;
+  }
+  if (!key(2, false, 0) || !key(0, false, SQUIRREL_TAPPING_TERM) ||
+      keyboard_get_modifiers() != 0 || typed(0) || typed(2)) {
+    return 27;
+  }
+  if (squirrel_default_ctx.timers.pending != 0) {
+    return 28;
+  }
+  // a combo pressed while a tap-hold key is undecided waits behind it, so a
+  // tap is typed before the combo
+  reset();
+  layer_set_key(0, 0, mod_tap(SHIFT, KEYCODE(0)));
+  if (!key(0, true, 5) || !key(4, true, 5) || !key(5, true, 0) ||
+      presses != 0) {
+    return 29;
+  }
+  if (!key(0, false, 0) || presses != 1 || !seen_a || seen_modifiers != 0) {
+    return 30;
+  }
+  if (!key(4, false, 0) || !key(5, false, 1) || releases != 1 ||
+      typed(0) || typed(4) || typed(5)) {
+    return 31;
+  }
+
+  // and the combo press is another key press that can decide it as a hold
+  reset();
+  layer_set_key(0, 0, mod_tap(SHIFT, KEYCODE(0)));
+  tap_hold_set_mode(TAP_HOLD_ON_OTHER_KEY_PRESS, 0);
+  if (!key(0, true, 5) || !key(4, true, 5) || !key(5, true, 0) ||
+      presses != 1 || seen_modifiers != SHIFT || seen_a) {
+    return 32;
+  }
+  if (!key(4, false, 0) || !key(5, false, 0) || !key(0, false, 1) ||
+      releases != 1 || keyboard_get_modifiers() != 0 || typed(0)) {
+    return 33;
+  }
+
+  return 0;
+}
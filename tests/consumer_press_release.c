@@ -1,5 +1,6 @@
 #include "squirrel.h"
 #include "squirrel_consumer.h"
+#include "squirrel_ctx.h"
 #include "squirrel_key.h"
 #include "squirrel_quantum.h"
 #include <stdint.h>
@@ -8,97 +9,98 @@
 
 // test: consumer_press + consumer_release - in squirrel_quantum.c
 int main() {
+  struct squirrel_ctx *ctx = &squirrel_default_ctx;
   struct key test_key; // values unused
   enum squirrel_error err;
   for (uint16_t test_consumer_code = 0; test_consumer_code != 0xFFFF;
        test_consumer_code++) {
     // consumer_press
     // no code becomes a code
-    consumer_code = 0;
-    err = consumer_press(0, 0, &test_consumer_code);
+    ctx->consumer_code = 0;
+    err = consumer_press(ctx, 0, 0, test_consumer_code);
     if (err != ERR_NONE) {
       printf("err while testing with test_consumer_code %d,\n",
              test_consumer_code);
       printf("err from consumer_press in test 1: %d\n", err);
       return 1;
     }
-    if (consumer_code != test_consumer_code) {
+    if (ctx->consumer_code != test_consumer_code) {
       printf("err while testing with test_consumer_code %d,\n",
              test_consumer_code);
       printf("consumer_code not equal to test_consumer_code in consumer_press "
              "test 1: "
              "%d\n",
-             consumer_code);
+             ctx->consumer_code);
       return 1;
     }
     // a code stays a code
-    err = consumer_press(0, 0, &test_consumer_code);
+    err = consumer_press(ctx, 0, 0, test_consumer_code);
     if (err != ERR_NONE) {
       printf("err while testing with test_consumer_code %d,\n",
              test_consumer_code);
       printf("err from consumer_press in test 2: %d\n", err);
       return 1;
     }
-    if (consumer_code != test_consumer_code) {
+    if (ctx->consumer_code != test_consumer_code) {
       printf("err while testing with test_consumer_code %d,\n",
              test_consumer_code);
       printf("consumer_code not equal to test_consumer_code in consumer_press "
              "test 2: "
              "%d\n",
-             consumer_code);
+             ctx->consumer_code);
       return 1;
     }
     // another code becomes a code
-    consumer_code = 0xFFFF;
-    err = consumer_press(0, 0, &test_consumer_code);
+    ctx->consumer_code = 0xFFFF;
+    err = consumer_press(ctx, 0, 0, test_consumer_code);
     if (err != ERR_NONE) {
       printf("err while testing with test_consumer_code %d,\n",
              test_consumer_code);
       printf("err from consumer_press in test 3: %d\n", err);
       return 1;
     }
-    if (consumer_code != test_consumer_code) {
+    if (ctx->consumer_code != test_consumer_code) {
       printf("err while testing with test_consumer_code %d,\n",
              test_consumer_code);
       printf("consumer_code not equal to test_consumer_code in consumer_press "
              "test 3: "
              "%d\n",
-             consumer_code);
+             ctx->consumer_code);
       return 1;
     }
 
     // consumer_release
     // a code becomes no code
-    consumer_code = test_consumer_code;
-    err = consumer_release(0, 0, &test_consumer_code);
+    ctx->consumer_code = test_consumer_code;
+    err = consumer_release(ctx, 0, 0, test_consumer_code);
     if (err != ERR_NONE) {
       printf("err while testing with test_consumer_code %d,\n",
              test_consumer_code);
       printf("err from consumer_release in test 1: %d\n", err);
       return 1;
     }
-    if (consumer_code != 0) {
+    if (ctx->consumer_code != 0) {
       printf("err while testing with test_consumer_code %d,\n",
              test_consumer_code);
       printf("consumer_code not equal to 0 in consumer_release test 1: %d\n",
-             consumer_code);
+             ctx->consumer_code);
       return 1;
     }
     // another code stays another code
-    consumer_code = 0xFFFF;
-    err = consumer_release(0, 0, &test_consumer_code);
+    ctx->consumer_code = 0xFFFF;
+    err = consumer_release(ctx, 0, 0, test_consumer_code);
     if (err != ERR_NONE) {
       printf("err while testing with test_consumer_code %d,\n",
              test_consumer_code);
       printf("err from consumer_release in test 2: %d\n", err);
       return 1;
     }
-    if (consumer_code != 0xFFFF) {
+    if (ctx->consumer_code != 0xFFFF) {
       printf("err while testing with test_consumer_code %d,\n",
              test_consumer_code);
       printf("consumer_code not equal to 0xFFFF in consumer_release test 2: "
              "%d\n",
-             consumer_code);
+             ctx->consumer_code);
       return 1;
     }
   }
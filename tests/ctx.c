@@ -0,0 +1,117 @@
+#include "squirrel.h"
+#include "squirrel_consumer.h"
+#include "squirrel_ctx.h"
+#include "squirrel_event.h"
+#include "squirrel_init.h"
+#include "squirrel_key.h"
+#include "squirrel_keyboard.h"
+#include "squirrel_keymap.h"
+#include "squirrel_quantum.h"
+#include "squirrel_report.h"
+#include <stddef.h>
+#include <stdint.h>
+
+static const struct key base[SQUIRREL_KEYCOUNT] = {KEY_KEYBOARD(0x04),
+                                                   KEY_LAYER_MOMENTARY(1)};
+
+struct squirrel_ctx *called_with = NULL;
+
+enum squirrel_error test_press(struct squirrel_ctx *ctx, uint8_t layer,
+                               squirrel_key_index_t key_index, uint16_t arg) {
+  (void)layer;
+  (void)key_index;
+  (void)arg;
+  called_with = ctx;
+  return ERR_NONE;
+}
+
+// test: squirrel_init_ctx + the _ctx functions - in every module
+int main() {
+  struct squirrel_ctx a;
+  struct squirrel_ctx b;
+  squirrel_init_ctx(&a);
+  squirrel_init_ctx(&b);
+  squirrel_init();
+
+  // both contexts can share one base keymap, and edit it separately
+  layer_set_keymap_ctx(&a, 0, base);
+  layer_set_keymap_ctx(&b, 0, base);
+  if (layer_set_key_ctx(&b, 0, 0, consumer(0xE9)) != ERR_NONE) {
+    return 1;
+  }
+  if (layer_get_key_ctx(&a, 0, 0).action != ACTION_KEYBOARD ||
+      layer_get_key_ctx(&b, 0, 0).action != ACTION_CONSUMER) {
+    return 2;
+  }
+  layer_set_active_ctx(&a, 0, true);
+  layer_set_active_ctx(&b, 0, true);
+
+  // a key press only changes the context it happened in
+  if (check_key_ctx(&a, 0, true) != ERR_NONE) {
+    return 3;
+  }
+  if (!keyboard_get_keycode_ctx(&a, 0x04) ||
+      keyboard_get_keycode_ctx(&b, 0x04) || keyboard_get_keycode(0x04)) {
+    return 4;
+  }
+  if (squirrel_report_changed_ctx(&a) != REPORT_CHANGED(REPORT_KEYBOARD) ||
+      squirrel_report_changed_ctx(&b) != 0 || squirrel_report_changed() != 0) {
+    return 5;
+  }
+  if (b.key_states[0] != 0 || squirrel_default_ctx.key_states[0] != 0) {
+    return 6;
+  }
+  if (check_key_ctx(&b, 0, true) != ERR_NONE) {
+    return 7;
+  }
+  if (consumer_get_consumer_code_ctx(&b) != 0xE9 ||
+      consumer_get_consumer_code_ctx(&a) != 0) {
+    return 8;
+  }
+
+  // layers are per context
+  if (check_key_ctx(&a, 1, true) != ERR_NONE) {
+    return 9;
+  }
+  if (a.active_layers != 0b11 || b.active_layers != 0b01) {
+    return 10;
+  }
+
+  // each context has its own event queue
+  squirrel_enqueue_event_ctx(&b, 0, false, 42);
+  if (squirrel_process_events_ctx(&a, 0) != ERR_NONE ||
+      consumer_get_consumer_code_ctx(&b) != 0xE9) {
+    return 11;
+  }
+  if (squirrel_process_events_ctx(&b, 0) != ERR_NONE ||
+      consumer_get_consumer_code_ctx(&b) != 0 ||
+      squirrel_event_time_ctx(&b) != 42 || squirrel_event_time_ctx(&a) != 0) {
+    return 12;
+  }
+
+  // keyfuncs are called with the context of the key
+  custom_actions[0] = (struct action){test_press, test_press};
+  layer_set_key_ctx(&b, 0, 1, custom(0, 0));
+  if (check_key_ctx(&b, 1, true) != ERR_NONE || called_with != &b) {
+    return 13;
+  }
+
+  // the functions without a suffix use the default context
+  layer_set_keymap(0, base);
+  layer_set_active(0, true);
+  if (check_key(0, true) != ERR_NONE) {
+    return 14;
+  }
+  if (!keyboard_get_keycode_ctx(&squirrel_default_ctx, 0x04)) {
+    return 15;
+  }
+
+  // squirrel_init_ctx forgets everything
+  squirrel_init_ctx(&a);
+  if (a.active_layers != 0 || a.key_states[0] != 0 ||
+      keyboard_get_keycode_ctx(&a, 0x04) ||
+      layer_get_key_ctx(&a, 0, 0).action != ACTION_PASSTHROUGH) {
+    return 16;
+  }
+  return 0;
+}
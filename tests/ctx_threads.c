@@ -0,0 +1,76 @@
+#include "squirrel.h"
+#include "squirrel_ctx.h"
+#include "squirrel_init.h"
+#include "squirrel_key.h"
+#include "squirrel_keyboard.h"
+#include "squirrel_keymap.h"
+#include "squirrel_quantum.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define THREADS 4
+#define CONTEXTS 256 // per thread
+#define SCANS 200    // per context
+
+// Key n types keycode 0x04 + n, so the keyboard report of every context can
+// be checked against the last scan it was given.
+static const struct key base[SQUIRREL_KEYCOUNT] = {
+    KEY_KEYBOARD(0x04), KEY_KEYBOARD(0x05), KEY_KEYBOARD(0x06),
+    KEY_KEYBOARD(0x07), KEY_KEYBOARD(0x08), KEY_KEYBOARD(0x09),
+    KEY_KEYBOARD(0x0A), KEY_KEYBOARD(0x0B)};
+
+struct squirrel_ctx keyboards[THREADS][CONTEXTS];
+atomic_int failed_thread = -1;
+
+// scan_for returns the keys held by a keyboard in a scan, different for every
+// keyboard so that any state leaking between them is caught.
+static uint8_t scan_for(int thread, int keyboard, int scan) {
+  uint32_t x = (thread * CONTEXTS + keyboard) * 2654435761u + scan * 40503u;
+  return x >> 24;
+}
+
+void *run(void *arg) {
+  int thread = (int)(intptr_t)arg;
+  for (int k = 0; k < CONTEXTS; k++) {
+    struct squirrel_ctx *ctx = &keyboards[thread][k];
+    squirrel_init_ctx(ctx);
+    layer_set_keymap_ctx(ctx, 0, base);
+    layer_set_active_ctx(ctx, 0, true);
+  }
+  for (int scan = 0; scan < SCANS; scan++) {
+    for (int k = 0; k < CONTEXTS; k++) {
+      struct squirrel_ctx *ctx = &keyboards[thread][k];
+      uint32_t bitmap[SQUIRREL_KEYSTATE_WORDS] = {0};
+      bitmap[0] = scan_for(thread, k, scan);
+      if (check_keys_ctx(ctx, bitmap) != ERR_NONE ||
+          ctx->keyboard_report.keycodes[0] >> 4 != (bitmap[0] & 0x0F) ||
+          ctx->keyboard_report.keycodes[1] != bitmap[0] >> 4) {
+        failed_thread = thread;
+        return NULL;
+      }
+    }
+    sched_yield(); // Interleave the threads even on a single core.
+  }
+  return NULL;
+}
+
+// test: many independent contexts driven from several threads at once - in
+// every module
+int main() {
+  pthread_t threads[THREADS];
+  for (int t = 0; t < THREADS; t++) {
+    pthread_create(&threads[t], NULL, run, (void *)(intptr_t)t);
+  }
+  for (int t = 0; t < THREADS; t++) {
+    pthread_join(threads[t], NULL);
+  }
+  if (failed_thread != -1) {
+    printf("a keyboard of thread %d did not match its scans\n", failed_thread);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,92 @@
+#include "squirrel.h"
+#include "squirrel_ctx.h"
+#include "squirrel_debounce.h"
+#include "squirrel_init.h"
+#include "squirrel_key.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// scan feeds one raw scan of key 0 to debounce_scan and reports whether key 0
+// is pressed afterwards.
+bool scan(uint32_t raw) {
+  uint32_t bitmap[SQUIRREL_KEYSTATE_WORDS] = {0};
+  bitmap[0] = raw;
+  if (debounce_scan(bitmap) != ERR_NONE) {
+    return !(squirrel_default_ctx.key_states[0] & 1);
+  }
+  return squirrel_default_ctx.key_states[0] & 1;
+}
+
+// test: debounce_set_mode + debounce_scan - in squirrel_debounce.c
+int main() {
+  squirrel_init();
+
+  // without debouncing, every scan is applied
+  debounce_set_mode(DEBOUNCE_NONE, 0);
+  if (!scan(1) || scan(0)) {
+    return 1;
+  }
+
+  // symmetric defer: the scan has to read the same 3 times in a row
+  debounce_set_mode(DEBOUNCE_SYM_DEFER, 3);
+  if (scan(1) || scan(1)) {
+    return 2;
+  }
+  if (!scan(1)) {
+    return 3;
+  }
+  if (!scan(0) || !scan(1) || !scan(0) || !scan(0)) {
+    return 4;
+  }
+  if (scan(0)) {
+    return 5;
+  }
+
+  // per key symmetric defer: the key has to read the same 3 times in a row
+  debounce_set_mode(DEBOUNCE_SYM_DEFER_PK, 3);
+  if (scan(1) || scan(0) || scan(1) || scan(1)) {
+    return 6;
+  }
+  if (!scan(1)) {
+    return 7;
+  }
+  if (!scan(0) || !scan(0) || !scan(1) || !scan(0) || !scan(0)) {
+    return 8;
+  }
+  if (scan(0)) {
+    return 9;
+  }
+
+  // eager defer: presses are immediate, releases need 3 scans in a row
+  debounce_set_mode(DEBOUNCE_EAGER_DEFER_PK, 3);
+  if (!scan(1)) {
+    return 10;
+  }
+  if (!scan(0) || !scan(0) || !scan(1) || !scan(0) || !scan(0)) {
+    return 11;
+  }
+  if (scan(0)) {
+    return 12;
+  }
+
+  // windows past DEBOUNCE_MAX_WINDOW are limited to it
+  debounce_set_mode(DEBOUNCE_SYM_DEFER_PK, 255);
+  for (int i = 0; i < DEBOUNCE_MAX_WINDOW - 1; i++) {
+    if (scan(1)) {
+      return 13;
+    }
+  }
+  if (!scan(1)) {
+    return 14;
+  }
+
+  // bits past the last key do not restart symmetric defer
+  debounce_set_mode(DEBOUNCE_SYM_DEFER, 3);
+  if (!scan(0) || !scan(1u << SQUIRREL_KEYCOUNT)) {
+    return 15;
+  }
+  if (scan(0)) {
+    return 16;
+  }
+  return 0;
+}
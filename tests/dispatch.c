@@ -0,0 +1,92 @@
+#include "squirrel.h"
+#include "squirrel_consumer.h"
+#include "squirrel_ctx.h"
+#include "squirrel_init.h"
+#include "squirrel_key.h"
+#include "squirrel_keyboard.h"
+#include "squirrel_keymap.h"
+#include "squirrel_quantum.h"
+#include <stdint.h>
+
+// test: dispatch_press + dispatch_release of every built-in action through
+// press_key and release_key - in squirrel_key.c. Built once with the actions
+// table and once with SQUIRREL_SWITCH_DISPATCH.
+int main() {
+  struct squirrel_ctx *ctx = &squirrel_default_ctx;
+  squirrel_init();
+  layer_set_active(0, true);
+
+  // keyboard
+  layer_set_key(0, 0, keyboard(0x04));
+  if (press_key(0) != ERR_NONE || !keyboard_get_keycode(0x04)) {
+    return 1;
+  }
+  if (release_key(0) != ERR_NONE || keyboard_get_keycode(0x04)) {
+    return 2;
+  }
+
+  // keyboard_modifier
+  layer_set_key(0, 0, keyboard_modifier(0b00000100));
+  if (press_key(0) != ERR_NONE || keyboard_get_modifiers() != 0b00000100) {
+    return 3;
+  }
+  if (release_key(0) != ERR_NONE || keyboard_get_modifiers() != 0) {
+    return 4;
+  }
+
+  // consumer
+  layer_set_key(0, 0, consumer(0x00E9));
+  if (press_key(0) != ERR_NONE || consumer_get_consumer_code() != 0x00E9) {
+    return 5;
+  }
+  if (release_key(0) != ERR_NONE || consumer_get_consumer_code() != 0) {
+    return 6;
+  }
+
+  // nop
+  layer_set_key(0, 0, nop());
+  if (press_key(0) != ERR_NONE || release_key(0) != ERR_NONE) {
+    return 7;
+  }
+
+  // layer_momentary
+  layer_set_key(0, 0, layer_momentary(2));
+  if (press_key(0) != ERR_NONE || !ctx->layers[2].active) {
+    return 8;
+  }
+  if (release_key(0) != ERR_NONE || ctx->layers[2].active) {
+    return 9;
+  }
+
+  // layer_toggle
+  layer_set_key(0, 0, layer_toggle(2));
+  if (press_key(0) != ERR_NONE || release_key(0) != ERR_NONE ||
+      !ctx->layers[2].active) {
+    return 10;
+  }
+  if (press_key(0) != ERR_NONE || release_key(0) != ERR_NONE ||
+      ctx->layers[2].active) {
+    return 11;
+  }
+
+  // layer_solo
+  layer_set_active(3, true);
+  layer_set_key(0, 0, layer_solo(0));
+  if (press_key(0) != ERR_NONE || release_key(0) != ERR_NONE ||
+      ctx->layers[3].active || !ctx->layers[0].active) {
+    return 12;
+  }
+
+  // passthrough on the bottom layer
+  layer_set_key(0, 0, passthrough());
+  if (press_key(0) != ERR_PASSTHROUGH_ON_BOTTOM_LAYER) {
+    return 13;
+  }
+
+  // unknown custom actions
+  layer_set_key(0, 0, custom(0, 0));
+  if (press_key(0) != ERR_UNKNOWN_ACTION) {
+    return 14;
+  }
+  return 0;
+}
@@ -0,0 +1,97 @@
+#include "squirrel.h"
+#include "squirrel_ctx.h"
+#include "squirrel_event.h"
+#include "squirrel_init.h"
+#include "squirrel_key.h"
+#include "squirrel_keymap.h"
+#include "squirrel_quantum.h"
+#include <stdint.h>
+
+uint8_t presses = 0;
+uint8_t releases = 0;
+uint32_t last_time = 0;
+
+enum squirrel_error test_press(struct squirrel_ctx *ctx, uint8_t layer,
+                               uint8_t key_index, uint16_t arg) {
+  presses++;
+  last_time = squirrel_event_time();
+  return ERR_NONE;
+}
+
+enum squirrel_error test_release(struct squirrel_ctx *ctx, uint8_t layer,
+                                 uint8_t key_index, uint16_t arg) {
+  releases++;
+  last_time = squirrel_event_time();
+  return ERR_NONE;
+}
+
+// test: squirrel_enqueue_event + squirrel_process_events +
+// squirrel_event_time + squirrel_event_overflows - in squirrel_event.c
+int main() {
+  squirrel_init();
+  custom_actions[0] = (struct action){test_press, test_release};
+  layer_set_key(0, 0, custom(0, 0));
+  layer_set_active(0, true);
+
+  // an empty queue does nothing
+  if (squirrel_process_events(0) != ERR_NONE || presses != 0) {
+    return 1;
+  }
+
+  // events are processed in order, with their timestamps
+  if (!squirrel_enqueue_event(0, true, 100) ||
+      !squirrel_enqueue_event(0, false, 200)) {
+    return 2;
+  }
+  if (presses != 0) { // nothing happens until the queue is processed
+    return 3;
+  }
+  if (squirrel_process_events(1) != ERR_NONE) {
+    return 4;
+  }
+  if (presses != 1 || releases != 0 || last_time != 100) {
+    return 5;
+  }
+  if (squirrel_process_events(0) != ERR_NONE) {
+    return 6;
+  }
+  if (presses != 1 || releases != 1 || last_time != 200) {
+    return 7;
+  }
+
+  // a full queue drops events and counts them
+  for (uint32_t i = 0; i < SQUIRREL_EVENT_QUEUE_CAPACITY; i++) {
+    if (!squirrel_enqueue_event(0, i % 2 == 0, i)) {
+      return 8;
+    }
+  }
+  if (squirrel_enqueue_event(0, true, 0)) {
+    return 9;
+  }
+  if (squirrel_event_overflows() != 1) {
+    return 10;
+  }
+  if (squirrel_process_events(0) != ERR_NONE) {
+    return 11;
+  }
+  if (presses != 1 + SQUIRREL_EVENT_QUEUE_CAPACITY / 2 ||
+      releases != 1 + SQUIRREL_EVENT_QUEUE_CAPACITY / 2) {
+    return 12;
+  }
+
+  // processing stops at the first error, leaving the rest queued
+  layer_set_key(0, 0, custom(1, 0)); // unset custom action
+  squirrel_enqueue_event(0, true, 1);
+  squirrel_enqueue_event(0, false, 2);
+  if (squirrel_process_events(0) != ERR_UNKNOWN_ACTION) {
+    return 13;
+  }
+  layer_set_key(0, 0, custom(0, 0));
+  if (squirrel_process_events(0) != ERR_NONE) {
+    return 14;
+  }
+  if (releases != 2 + SQUIRREL_EVENT_QUEUE_CAPACITY / 2 || last_time != 2) {
+    return 15;
+  }
+  return 0;
+}
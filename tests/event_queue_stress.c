@@ -0,0 +1,97 @@
+#include "squirrel.h"
+#include "squirrel_ctx.h"
+#include "squirrel_event.h"
+#include "squirrel_init.h"
+#include "squirrel_key.h"
+#include "squirrel_keymap.h"
+#include "squirrel_quantum.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define EVENTS 2000000
+
+uint32_t presses = 0;
+uint32_t releases = 0;
+uint32_t expected_time = 0;
+bool out_of_order = false;
+atomic_bool producer_done = false;
+
+// Every event is a press or release of key 0, alternating, with timestamps
+// counting up from 0. The consumer checks that it sees exactly that sequence.
+enum squirrel_error test_press(struct squirrel_ctx *ctx, uint8_t layer,
+                               uint8_t key_index, uint16_t arg) {
+  if (squirrel_event_time() != expected_time) {
+    out_of_order = true;
+  }
+  expected_time++;
+  presses++;
+  return ERR_NONE;
+}
+
+enum squirrel_error test_release(struct squirrel_ctx *ctx, uint8_t layer,
+                                 uint8_t key_index, uint16_t arg) {
+  if (squirrel_event_time() != expected_time) {
+    out_of_order = true;
+  }
+  expected_time++;
+  releases++;
+  return ERR_NONE;
+}
+
+void *produce(void *arg) {
+  (void)arg;
+  for (uint32_t i = 0; i < EVENTS; i++) {
+    while (!squirrel_enqueue_event(0, i % 2 == 0, i)) {
+      sched_yield(); // The queue is full, let the consumer run.
+    }
+  }
+  atomic_store(&producer_done, true);
+  return NULL;
+}
+
+void *consume(void *arg) {
+  (void)arg;
+  while (presses + releases < EVENTS) {
+    uint32_t before = presses + releases;
+    if (squirrel_process_events(16) != ERR_NONE) {
+      out_of_order = true;
+      return NULL;
+    }
+    if (presses + releases == before) {
+      sched_yield(); // The queue is empty, let the producer run.
+    }
+  }
+  return NULL;
+}
+
+// test: squirrel_enqueue_event + squirrel_process_events from two threads -
+// in squirrel_event.c
+int main() {
+  squirrel_init();
+  custom_actions[0] = (struct action){test_press, test_release};
+  layer_set_key(0, 0, custom(0, 0));
+  layer_set_active(0, true);
+
+  pthread_t producer_thread, consumer_thread;
+  pthread_create(&consumer_thread, NULL, consume, NULL);
+  pthread_create(&producer_thread, NULL, produce, NULL);
+  pthread_join(producer_thread, NULL);
+  pthread_join(consumer_thread, NULL);
+
+  if (!atomic_load(&producer_done)) {
+    return 1;
+  }
+  if (out_of_order) {
+    printf("events were lost, duplicated or reordered near %u\n",
+           expected_time);
+    return 2;
+  }
+  if (presses != EVENTS / 2 || releases != EVENTS / 2) {
+    printf("presses: %u, releases: %u\n", presses, releases);
+    return 3;
+  }
+  return 0;
+}
@@ -0,0 +1,115 @@
+#include "squirrel.h"
+#include "squirrel_ctx.h"
+#include "squirrel_init.h"
+#include "squirrel_instrument.h"
+#include "squirrel_key.h"
+#include "squirrel_keymap.h"
+#include "squirrel_quantum.h"
+#include <stdint.h>
+#include <stdlib.h>
+
+uint32_t fake_time = 0;
+
+// fake_clock advances by one tick every time it is read.
+uint32_t fake_clock(void) { return fake_time++; }
+
+// custom_nop is a custom action that does nothing.
+enum squirrel_error custom_nop(struct squirrel_ctx *ctx, uint8_t layer,
+                               squirrel_key_index_t key_index, uint16_t arg) {
+  (void)ctx;
+  (void)layer;
+  (void)key_index;
+  (void)arg;
+  return ERR_NONE;
+}
+
+// test: instrument_set_clock + instrument_snapshot + instrument_reset, and the
+// instrumented hot paths - in squirrel_instrument.c
+int main() {
+  squirrel_init();
+  layer_set_key(0, 0, keyboard(0x04));
+  layer_set_active(0, true);
+  layer_set_active(1, true);
+  layer_set_active(2, true);
+
+  instrument_set_clock(fake_clock);
+  instrument_reset();
+  press_key(0);
+  release_key(0);
+
+  struct instrument_stats stats;
+  instrument_snapshot(&stats);
+  if (stats.points[INSTRUMENT_PRESS_KEY].calls != 1 ||
+      stats.points[INSTRUMENT_RELEASE_KEY].calls != 1) {
+    return 1;
+  }
+  // Only the press walked the layers, the release used the held key.
+  if (stats.points[INSTRUMENT_PASSTHROUGH].calls != 1) {
+    return 2;
+  }
+  if (stats.max_passthrough_depth != 2) {
+    return 3;
+  }
+  if (stats.dispatches[ACTION_KEYBOARD].calls != 2 ||
+      stats.dispatches[ACTION_NOP].calls != 0) {
+    return 4;
+  }
+  // Reading the clock takes one tick, so each stop is one tick after its
+  // start, and press_key includes the walk and the dispatch.
+  struct instrument_timing walk = stats.points[INSTRUMENT_PASSTHROUGH];
+  if (walk.min != 1 || walk.max != 1 || walk.total != 1) {
+    return 5;
+  }
+  struct instrument_timing press = stats.points[INSTRUMENT_PRESS_KEY];
+  if (press.min != 5 || press.max != 5 || press.total != 5) {
+    return 6;
+  }
+  struct instrument_timing dispatch = stats.dispatches[ACTION_KEYBOARD];
+  if (dispatch.min != 1 || dispatch.max != 1 || dispatch.total != 2) {
+    return 7;
+  }
+
+  instrument_reset();
+  instrument_snapshot(&stats);
+  if (stats.points[INSTRUMENT_PRESS_KEY].calls != 0 ||
+      stats.dispatches[ACTION_KEYBOARD].calls != 0 ||
+      stats.max_passthrough_depth != 0) {
+    return 8;
+  }
+
+  // Without a clock, calls are still counted.
+  instrument_set_clock(NULL);
+  press_key(0);
+  instrument_snapshot(&stats);
+  if (stats.points[INSTRUMENT_PRESS_KEY].calls != 1 ||
+      stats.points[INSTRUMENT_PRESS_KEY].max != 0) {
+    return 9;
+  }
+
+  // Each context counts its own calls.
+  struct squirrel_ctx other;
+  squirrel_init_ctx(&other);
+  layer_set_key_ctx(&other, 0, 0, keyboard(0x04));
+  layer_set_active_ctx(&other, 0, true);
+  press_key_ctx(&other, 0);
+  release_key_ctx(&other, 0);
+  instrument_snapshot_ctx(&other, &stats);
+  if (stats.points[INSTRUMENT_PRESS_KEY].calls != 1 ||
+      stats.points[INSTRUMENT_RELEASE_KEY].calls != 1) {
+    return 10;
+  }
+  instrument_snapshot(&stats);
+  if (stats.points[INSTRUMENT_RELEASE_KEY].calls != 0) {
+    return 11;
+  }
+
+  // Custom actions are timed after the built-in ones.
+  custom_actions[1] = (struct action){custom_nop, custom_nop};
+  instrument_reset();
+  dispatch_press(custom(1, 0), 0, 0);
+  instrument_snapshot(&stats);
+  if (stats.dispatches[ACTION_BUILTIN_COUNT + 1].calls != 1) {
+    return 12;
+  }
+  return 0;
+}
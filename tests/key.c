@@ -1,26 +1,32 @@
 #include "squirrel.h"
+#include "squirrel_ctx.h"
 #include "squirrel_init.h"
 #include "squirrel_key.h"
+#include "squirrel_keymap.h"
 #include "squirrel_quantum.h"
 #include <stdarg.h>
 #include <stdlib.h>
 
 uint8_t test_result = 1;
 
-enum squirrel_error test_press(uint8_t layer, uint8_t key_index, void *arg) {
+enum squirrel_error test_press(struct squirrel_ctx *ctx, uint8_t layer,
+                               uint8_t key_index, uint16_t arg) {
+  (void)ctx;
   (void)layer;
   (void)key_index;
-  uint8_t code = *(uint8_t *)arg;
+  uint8_t code = arg;
   if (code == 0xF0) {
     test_result = 0;
   }
   return ERR_NONE;
 }
 
-enum squirrel_error test_release(uint8_t layer, uint8_t key_index, void *arg) {
+enum squirrel_error test_release(struct squirrel_ctx *ctx, uint8_t layer,
+                                 uint8_t key_index, uint16_t arg) {
+  (void)ctx;
   (void)layer;
   (void)key_index;
-  uint8_t code = *(uint8_t *)arg;
+  uint8_t code = arg;
   if (code == 0xF0) {
     test_result = 0;
   }
@@ -31,18 +37,15 @@ enum squirrel_error test_release(uint8_t layer, uint8_t key_index, void *arg) {
 #define SQUIRREL_KEYCOUNT 1
 
 int main() {
+  struct squirrel_ctx *ctx = &squirrel_default_ctx;
   squirrel_init();
 
   // press_key + release_key
   uint8_t code = 0xF0;
 
-  struct key testkey;
-  testkey.pressed = test_press;
-  testkey.pressed_argument = &code;
-  testkey.released = test_release;
-  testkey.released_argument = &code;
-  copy_key(&testkey, &layers[0].keys[0]);
-  layers[0].active = true;
+  custom_actions[0] = (struct action){test_press, test_release};
+  layer_set_key(0, 0, custom(0, code));
+  layer_set_active(0, true);
 
   // check that arguments are correct, and in the correct order.
   enum squirrel_error err = press_key(0);
@@ -52,11 +55,12 @@ int main() {
   if (test_result != 0) {
     return 3;
   }
-  // keys are copied to layer 17 (index 16) when pressed, to avoid layer issues.
-  if (layers[16].keys[0].pressed_argument != &code) {
+  // pressed keys remember the layer they were pressed on, to avoid layer
+  // issues.
+  if (!(ctx->held_keys[0] & 1)) {
     return 4;
   }
-  if (layers[16].keys[0].pressed_argument != &code) {
+  if (ctx->held_from_layer[0] != 0) {
     return 5;
   }
 
@@ -68,17 +72,14 @@ int main() {
   if (test_result != 0) {
     return 7;
   }
-  // Keys are replaced with passthrough on layer 17 when released.
-  if (layers[16].keys[0].pressed_argument != NULL) {
+  // Keys are no longer held when released.
+  if (ctx->held_keys[0] & 1) {
     return 8;
   }
-  if (layers[16].keys[0].released_argument != NULL) {
-    return 9;
-  }
 
   // check_key
   test_result = 1;
-  key_states[0] = false;
+  ctx->key_states[0] = false;
   err = check_key(0, true); // should call press_key
   if (err != ERR_NONE) {
     return 10;
@@ -86,12 +87,12 @@ int main() {
   if (test_result != 0) {
     return 11;
   }
-  if (key_states[0] != true) {
+  if (ctx->key_states[0] != true) {
     return 12;
   }
 
   test_result = 1;
-  key_states[0] = true;
+  ctx->key_states[0] = true;
   err = check_key(0, false); // should call release_key
   if (err != ERR_NONE) {
     return 13;
@@ -99,12 +100,12 @@ int main() {
   if (test_result != 0) {
     return 14;
   }
-  if (key_states[0] != false) {
+  if (ctx->key_states[0] != false) {
     return 15;
   }
 
   test_result = 1;
-  key_states[0] = true;
+  ctx->key_states[0] = true;
   err = check_key(0, true); // should not call press_key
   if (err != ERR_NONE) {
     return 16;
@@ -112,12 +113,12 @@ int main() {
   if (test_result != 1) {
     return 17;
   }
-  if (key_states[0] != true) {
+  if (ctx->key_states[0] != true) {
     return 18;
   }
 
   test_result = 1;
-  key_states[0] = false;
+  ctx->key_states[0] = false;
   err = check_key(0, false); // should not call release_key
   if (err != ERR_NONE) {
     return 19;
@@ -125,9 +126,58 @@ int main() {
   if (test_result != 1) {
     return 20;
   }
-  if (key_states[0] != false) {
+  if (ctx->key_states[0] != false) {
     return 21;
   }
 
+  // dispatch_press + dispatch_release
+  // custom actions that are out of range or unset are errors.
+  if (dispatch_press(custom(SQUIRREL_CUSTOM_ACTION_COUNT, 0), 0, 0) !=
+      ERR_UNKNOWN_ACTION) {
+    return 22;
+  }
+  if (dispatch_release(custom(1, 0), 0, 0) != ERR_UNKNOWN_ACTION) {
+    return 23;
+  }
+
+  // a held key is released on the layer it was pressed on, even if that layer
+  // is deactivated while it is held.
+  layer_set_key(1, 0, keyboard(0x05));
+  layer_set_active(1, true);
+  if (press_key(0) != ERR_NONE || !keyboard_get_keycode(0x05)) {
+    return 24;
+  }
+  layer_set_active(1, false);
+  if (release_key(0) != ERR_NONE || keyboard_get_keycode(0x05)) {
+    return 25;
+  }
+  if (ctx->held_keys[0] & 1) {
+    return 26;
+  }
+
+  // a held key releases what it pressed, even if it is remapped while held.
+  layer_set_key(0, 0, keyboard(0x04));
+  if (press_key(0) != ERR_NONE || !keyboard_get_keycode(0x04)) {
+    return 27;
+  }
+  layer_set_key(0, 0, keyboard(0x06));
+  if (keyboard_get_keycode(0x04) || !(ctx->held_keys[0] & 1)) {
+    return 28; // released as soon as it was remapped
+  }
+  if (release_key(0) != ERR_NONE || keyboard_get_keycode(0x04) ||
+      keyboard_get_keycode(0x06) || (ctx->held_keys[0] & 1)) {
+    return 29;
+  }
+
+  // the numbers between the built-in and the custom actions are unknown
+  struct key unknown = {.action = ACTION_BUILTIN_COUNT};
+  if (dispatch_press(unknown, 0, 0) != ERR_UNKNOWN_ACTION) {
+    return 30;
+  }
+  unknown.action = ACTION_CUSTOM - 1;
+  if (dispatch_release(unknown, 0, 0) != ERR_UNKNOWN_ACTION) {
+    return 31;
+  }
+
   return 0;
 }
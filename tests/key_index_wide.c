@@ -0,0 +1,65 @@
+#include "squirrel.h"
+#include "squirrel_ctx.h"
+#include "squirrel_init.h"
+#include "squirrel_key.h"
+#include "squirrel_keyboard.h"
+#include "squirrel_keymap.h"
+#include "squirrel_quantum.h"
+#include <stdint.h>
+
+squirrel_key_index_t last_key_index = 0;
+
+enum squirrel_error test_press(struct squirrel_ctx *ctx, uint8_t layer,
+                               squirrel_key_index_t key_index, uint16_t arg) {
+  (void)ctx;
+  (void)layer;
+  (void)arg;
+  last_key_index = key_index;
+  return ERR_NONE;
+}
+
+// test: keys past index 255 - in squirrel_key.c and squirrel_quantum.c
+int main() {
+  struct squirrel_ctx *ctx = &squirrel_default_ctx;
+  if (sizeof(squirrel_key_index_t) != 2) {
+    return 1;
+  }
+  squirrel_init();
+  custom_actions[0] = (struct action){test_press, key_nop};
+  layer_set_key(0, 299, custom(0, 0));
+  layer_set_key(1, 256, keyboard(0x04));
+  layer_set_active(0, true);
+  layer_set_active(1, true);
+
+  // keys past 255 resolve and dispatch with their full index
+  if (resolve_layer(299) != 0 || resolve_layer(256) != 1 ||
+      resolve_layer(0) != 0) {
+    return 2;
+  }
+  if (press_key(299) != ERR_NONE || last_key_index != 299) {
+    return 3;
+  }
+  if (release_key(299) != ERR_NONE) {
+    return 4;
+  }
+
+  // check_keys walks every word of the scan
+  uint32_t bitmap[SQUIRREL_KEYSTATE_WORDS] = {0};
+  bitmap[256 / 32] = 1u << (256 % 32);
+  if (check_keys(bitmap) != ERR_NONE || !keyboard_get_keycode(0x04)) {
+    return 5;
+  }
+  if (!(ctx->held_keys[256 / 32] & 1) || ctx->held_from_layer[256] != 1) {
+    return 6;
+  }
+  bitmap[256 / 32] = 0;
+  if (check_keys(bitmap) != ERR_NONE || keyboard_get_keycode(0x04)) {
+    return 7;
+  }
+
+  // the key at index 0 is not confused with the key at index 256
+  if (layer_get_key(1, 0).action != ACTION_PASSTHROUGH) {
+    return 8;
+  }
+  return 0;
+}
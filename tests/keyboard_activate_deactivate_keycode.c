@@ -11,12 +11,12 @@ int main() {
   for (uint8_t test_keycode = 0; test_keycode <= 254; test_keycode++) {
     // keyboard_activate_keycode
     keyboard_activate_keycode(test_keycode);
-    if (keyboard_keycodes[test_keycode] != true) {
+    if (keyboard_get_keycode(test_keycode) != true) {
       return 1;
     }
     // keyboard_deactivate_keycode
     keyboard_deactivate_keycode(test_keycode);
-    if (keyboard_keycodes[test_keycode] != false) {
+    if (keyboard_get_keycode(test_keycode) != false) {
       return 2;
     }
   }
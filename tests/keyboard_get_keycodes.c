@@ -13,7 +13,7 @@ int main() {
     }
   }
   for (int i = 0; i < 6; i++) {
-    keyboard_keycodes[i] = true;
+    keyboard_activate_keycode(i);
   }
   keyboard_get_keycodes(&active_keycodes);
   for (uint8_t i = 0; i < 6; i++) {
@@ -21,12 +21,29 @@ int main() {
       return 2;
     }
   }
-  keyboard_keycodes[7] = true;
+  keyboard_activate_keycode(7);
   keyboard_get_keycodes(&active_keycodes);
   for (uint8_t i = 0; i < 6; i++) {
     if (active_keycodes[i] != i) {
       return 3;
     }
   }
+  // keycodes spread across the bitmap are returned in ascending order
+  for (int i = 0; i <= 0xFF; i++) {
+    keyboard_deactivate_keycode(i);
+  }
+  if (keyboard_get_keycodes(&active_keycodes)) {
+    return 4;
+  }
+  keyboard_activate_keycode(0xFF);
+  keyboard_activate_keycode(0x20);
+  keyboard_activate_keycode(0x1F);
+  if (!keyboard_get_keycodes(&active_keycodes)) {
+    return 5;
+  }
+  if (active_keycodes[0] != 0x1F || active_keycodes[1] != 0x20 ||
+      active_keycodes[2] != 0xFF) {
+    return 6;
+  }
   return 0;
 };
@@ -0,0 +1,67 @@
+#include "squirrel.h"
+#include "squirrel_ctx.h"
+#include "squirrel_keyboard.h"
+#include <stdint.h>
+
+// test: keyboard_set_report_mode + keyboard_get_report_mode +
+// keyboard_get_report - in squirrel_keyboard.c
+int main() {
+  const uint8_t *report;
+
+  // boot mode is the default
+  if (keyboard_get_report_mode() != KEYBOARD_REPORT_MODE_BOOT) {
+    return 1;
+  }
+
+  keyboard_activate_modifier(0b00000010);
+  for (uint8_t i = 1; i <= 8; i++) {
+    keyboard_activate_keycode(i * 0x10);
+  }
+
+  // boot mode: modifiers, reserved byte, then the first 6 keycodes
+  if (keyboard_get_report(&report) != 8) {
+    return 2;
+  }
+  if (report[0] != 0b00000010 || report[1] != 0) {
+    return 3;
+  }
+  for (uint8_t i = 0; i < 6; i++) {
+    if (report[2 + i] != (i + 1) * 0x10) {
+      return 4;
+    }
+  }
+  // unused slots are cleared
+  for (uint8_t i = 4; i <= 8; i++) {
+    keyboard_deactivate_keycode(i * 0x10);
+  }
+  keyboard_get_report(&report);
+  if (report[2] != 0x10 || report[4] != 0x30 || report[5] != 0) {
+    return 5;
+  }
+  for (uint8_t i = 4; i <= 8; i++) {
+    keyboard_activate_keycode(i * 0x10);
+  }
+
+  // nkro mode: the live report, with every keycode present
+  keyboard_set_report_mode(KEYBOARD_REPORT_MODE_NKRO);
+  if (keyboard_get_report_mode() != KEYBOARD_REPORT_MODE_NKRO) {
+    return 6;
+  }
+  if (keyboard_get_report(&report) != 33) {
+    return 7;
+  }
+  if (report != (const uint8_t *)&squirrel_default_ctx.keyboard_report) {
+    return 8;
+  }
+  if (report[0] != 0b00000010) {
+    return 9;
+  }
+  for (int keycode = 0; keycode <= 0xFF; keycode++) {
+    bool expected = keycode != 0 && keycode % 0x10 == 0 && keycode <= 0x80;
+    bool actual = (report[1 + keycode / 8] >> (keycode % 8)) & 1;
+    if (actual != expected) {
+      return 10;
+    }
+  }
+  return 0;
+}
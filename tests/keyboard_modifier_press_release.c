@@ -1,4 +1,5 @@
 #include "squirrel.h"
+#include "squirrel_ctx.h"
 #include "squirrel_key.h"
 #include "squirrel_quantum.h"
 #include <stdint.h>
@@ -7,29 +8,32 @@
 // test: keyboard_modifier_press + keyboard_modifier_release test - in
 // squirrel_quantum.c
 int main() {
+  struct squirrel_ctx *ctx = &squirrel_default_ctx;
   struct key test_key; // values unused
   // keyboard_modifier_press
 
   // no modifiers adding no modifiers is no modifiers
   uint8_t current_modifier = 0b00000000;
-  keyboard_modifiers = 0;
-  enum squirrel_error err = keyboard_modifier_press(0, 0, &current_modifier);
+  ctx->keyboard_report.modifiers = 0;
+  enum squirrel_error err =
+      keyboard_modifier_press(ctx, 0, 0, current_modifier);
   if (err != ERR_NONE) {
     return 255;
   }
-  if (keyboard_modifiers != 0b00000000) {
+  if (ctx->keyboard_report.modifiers != 0b00000000) {
     return 1;
   }
 
   // no modifiers adding a modifier is a modifier
   current_modifier = 0b00000001;
   for (uint8_t i = 0; i < 8; i++) {
-    keyboard_modifiers = 0;
-    enum squirrel_error err = keyboard_modifier_press(0, 0, &current_modifier);
+    ctx->keyboard_report.modifiers = 0;
+    enum squirrel_error err =
+        keyboard_modifier_press(ctx, 0, 0, current_modifier);
     if (err != ERR_NONE) {
       return 255;
     }
-    if (keyboard_modifiers != current_modifier) {
+    if (ctx->keyboard_report.modifiers != current_modifier) {
       return 2;
     }
     current_modifier = current_modifier << 1;
@@ -39,12 +43,13 @@ int main() {
   current_modifier = 0b00000001;
   for (uint8_t i = 0; i < 8; i++) {
     // modifiers stack, ORd to become the same number
-    uint8_t old_modifiers = keyboard_modifiers;
-    enum squirrel_error err = keyboard_modifier_press(0, 0, &current_modifier);
+    uint8_t old_modifiers = ctx->keyboard_report.modifiers;
+    enum squirrel_error err =
+        keyboard_modifier_press(ctx, 0, 0, current_modifier);
     if (err != ERR_NONE) {
       return 255;
     }
-    if (keyboard_modifiers != (old_modifiers | current_modifier)) {
+    if (ctx->keyboard_report.modifiers != (old_modifiers | current_modifier)) {
       return 3;
     }
     current_modifier = current_modifier << 1;
@@ -54,25 +59,25 @@ int main() {
 
   // no modifiers removing no modifiers is no modifiers
   current_modifier = 0b00000000;
-  keyboard_modifiers = 0;
-  err = keyboard_modifier_release(0, 0, &current_modifier);
+  ctx->keyboard_report.modifiers = 0;
+  err = keyboard_modifier_release(ctx, 0, 0, current_modifier);
   if (err != ERR_NONE) {
     return 255;
   }
-  if (keyboard_modifiers != 0b00000000) {
+  if (ctx->keyboard_report.modifiers != 0b00000000) {
     return 4;
   }
 
   // a modifier removing a modifier is no modifiers
   current_modifier = 0b00000001;
   for (uint8_t i = 0; i < 8; i++) {
-    keyboard_modifiers = current_modifier;
+    ctx->keyboard_report.modifiers = current_modifier;
     enum squirrel_error err =
-        keyboard_modifier_release(0, 0, &current_modifier);
+        keyboard_modifier_release(ctx, 0, 0, current_modifier);
     if (err != ERR_NONE) {
       return 255;
     }
-    if (keyboard_modifiers != 0b000000000) {
+    if (ctx->keyboard_report.modifiers != 0b000000000) {
       return 5;
     }
     current_modifier = current_modifier << 1;
@@ -80,16 +85,16 @@ int main() {
 
   // more than one modifier removing a modifier is less modifiers.
   current_modifier = 0b00000001;
-  keyboard_modifiers = 0b11111111;
+  ctx->keyboard_report.modifiers = 0b11111111;
   for (uint8_t i = 0; i < 8; i++) {
     // modifiers stack, ORd to become the same number
-    uint8_t old_modifiers = keyboard_modifiers;
+    uint8_t old_modifiers = ctx->keyboard_report.modifiers;
     enum squirrel_error err =
-        keyboard_modifier_release(0, 0, &current_modifier);
+        keyboard_modifier_release(ctx, 0, 0, current_modifier);
     if (err != ERR_NONE) {
       return 255;
     }
-    if (keyboard_modifiers != (old_modifiers & ~current_modifier)) {
+    if (ctx->keyboard_report.modifiers != (old_modifiers & ~current_modifier)) {
       return 6;
     }
     current_modifier = current_modifier << 1;
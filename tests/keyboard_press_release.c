@@ -1,4 +1,5 @@
 #include "squirrel.h"
+#include "squirrel_ctx.h"
 #include "squirrel_key.h"
 #include "squirrel_quantum.h"
 #include <stdint.h>
@@ -6,44 +7,45 @@
 
 // test: keyboard_press + keyboard_release - in squirrel_quantum.c
 int main() {
+  struct squirrel_ctx *ctx = &squirrel_default_ctx;
   struct key test_key; // values unused
   enum squirrel_error err;
   for (uint8_t keycode = 0; keycode != 255; keycode++) {
     // keyboard_press
     // Off becomes on
-    keyboard_keycodes[keycode] = false;
-    err = keyboard_press(0, 0, &keycode);
+    keyboard_deactivate_keycode(keycode);
+    err = keyboard_press(ctx, 0, 0, keycode);
     if (err != ERR_NONE) {
       return 1;
     }
-    if (keyboard_keycodes[keycode] != true) {
+    if (keyboard_get_keycode(keycode) != true) {
       return 2;
     }
     // On stays on
-    err = keyboard_press(0, 0, &keycode);
+    err = keyboard_press(ctx, 0, 0, keycode);
     if (err != ERR_NONE) {
       return 3;
     }
-    if (keyboard_keycodes[keycode] != true) {
+    if (keyboard_get_keycode(keycode) != true) {
       return 4;
     }
 
     // keyboard_release
     // On becomes off
-    keyboard_keycodes[keycode] = true;
-    err = keyboard_release(0, 0, &keycode);
+    keyboard_activate_keycode(keycode);
+    err = keyboard_release(ctx, 0, 0, keycode);
     if (err != ERR_NONE) {
       return 5;
     }
-    if (keyboard_keycodes[keycode] != false) {
+    if (keyboard_get_keycode(keycode) != false) {
       return 6;
     }
     // Off stays off
-    err = keyboard_release(0, 0, &keycode);
+    err = keyboard_release(ctx, 0, 0, keycode);
     if (err != ERR_NONE) {
       return 7;
     }
-    if (keyboard_keycodes[keycode] != false) {
+    if (keyboard_get_keycode(keycode) != false) {
       return 8;
     }
   }
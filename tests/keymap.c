@@ -9,13 +9,33 @@
 int main() {
   squirrel_init();
 
-  layers[0].keys[0] = keyboard(0x00);
-  layers[0].keys[1] = keyboard(0x01);
+  layer_set_key(0, 0, keyboard(0x00));
+  layer_set_key(0, 1, keyboard(0x01));
 
-  if (*(uint8_t *)(layers[0].keys[0].pressed_argument) != 0x00) {
+  if (layer_get_key(0, 0).argument != 0x00) {
     return 1;
   }
-  if (*(uint8_t *)(layers[0].keys[1].pressed_argument) != 0x01) {
+  if (layer_get_key(0, 1).argument != 0x01) {
     return 2;
   }
+  if (layer_get_key(0, 0).action != ACTION_KEYBOARD) {
+    return 3;
+  }
+  if (consumer(0xABCD).action != ACTION_CONSUMER ||
+      consumer(0xABCD).argument != 0xABCD) {
+    return 4;
+  }
+  if (custom(3, 7).action != ACTION_CUSTOM + 3 || custom(3, 7).argument != 7) {
+    return 5;
+  }
+  if (passthrough().action != ACTION_PASSTHROUGH) {
+    return 6;
+  }
+  static const struct key constant[] = {KEY_CUSTOM(3, 7), KEY_LAYER_SOLO(2)};
+  if (constant[0].action != custom(3, 7).action ||
+      constant[0].argument != custom(3, 7).argument ||
+      constant[1].action != layer_solo(2).action ||
+      constant[1].argument != layer_solo(2).argument) {
+    return 7;
+  }
 }
@@ -0,0 +1,178 @@
+#include "squirrel.h"
+#include "squirrel_ctx.h"
+#include "squirrel_init.h"
+#include "squirrel_key.h"
+#include "squirrel_keyboard.h"
+#include "squirrel_keymap.h"
+#include "squirrel_keymap_format.h"
+#include "squirrel_quantum.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Layer 0 is dense, layer 1 only has keys 3 and 33, layer 2 is empty but for
+// one runtime edit, and the rest pass through.
+static const uint32_t present[SQUIRREL_KEYSTATE_WORDS] = {1u << 3, 1u << 1};
+static const struct key sparse[] = {KEY_LAYER_MOMENTARY(2),
+                                    KEY_KEYBOARD(0x30)};
+static struct key dense[SQUIRREL_KEYCOUNT];
+
+static uint32_t saved[KEYMAP_FORMAT_MAX_SIZE / 4];
+static uint32_t copy[KEYMAP_FORMAT_MAX_SIZE / 4 + 1];
+
+// same_keys returns true if every layer of the context has the same keys as
+// the default context.
+bool same_keys(struct squirrel_ctx *ctx) {
+  for (uint8_t layer = 0; layer < SQUIRREL_LAYER_COUNT; layer++) {
+    for (int i = 0; i < SQUIRREL_KEYCOUNT; i++) {
+      struct key a = layer_get_key(layer, i);
+      struct key b = layer_get_key_ctx(ctx, layer, i);
+      if (a.action != b.action || a.argument != b.argument) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// within returns true if pointer points into the first size bytes of buffer.
+bool within(const void *pointer, const void *buffer, size_t size) {
+  const uint8_t *p = pointer;
+  const uint8_t *b = buffer;
+  return p >= b && p < b + size;
+}
+
+// test: keymap_save + keymap_load - in squirrel_keymap_format.c
+int main() {
+  squirrel_init();
+  for (int i = 0; i < SQUIRREL_KEYCOUNT; i++) {
+    dense[i] = keyboard(0x04 + i);
+  }
+  dense[5] = passthrough();
+  layer_set_keymap(0, dense);
+  layer_set_sparse_keymap(1, present, sparse);
+  layer_set_key(2, 7, consumer(0xE9));
+  layer_set_key(0, 6, mod_tap(0x02, 0x05));
+  layer_set_key(0, 8, layer_tap(1, 0x06));
+
+  // a buffer that is too small is refused, and told the size needed
+  size_t written = 0;
+  if (keymap_save(saved, 16, &written) != ERR_KEYMAP_TOO_SMALL) {
+    return 1;
+  }
+  size_t needed = written;
+  // header, 3 layers, a dense layer, and two sparse layers
+  size_t expected = 16 + 3 * 8 + SQUIRREL_KEYCOUNT * 4 + (8 + 2 * 4) +
+                    (8 + 1 * 4);
+  if (needed != expected) {
+    return 2;
+  }
+  if (keymap_save(saved, sizeof(saved), &written) != ERR_NONE ||
+      written != needed || memcmp(saved, "SQKM", 4) != 0) {
+    return 3;
+  }
+
+  // loading gives another context the same keys, edits included, without
+  // copying them
+  struct squirrel_ctx ctx;
+  squirrel_init_ctx(&ctx);
+  layer_set_key_ctx(&ctx, 3, 0, keyboard(0x10)); // forgotten by the load
+  if (keymap_load_ctx(&ctx, saved, written) != ERR_NONE || !same_keys(&ctx)) {
+    return 4;
+  }
+  if (!within(ctx.layers[0].keys, saved, written) ||
+      ctx.layers[0].present != NULL ||
+      !within(ctx.layers[1].present, saved, written) ||
+      !within(ctx.layers[2].keys, saved, written) || ctx.overlay.count != 0 ||
+      ctx.layers[3].keys != NULL) {
+    return 5;
+  }
+
+  // keys work as usual after a load
+  layer_set_active_ctx(&ctx, 0, true);
+  check_key_ctx(&ctx, 0, true);
+  if (!keyboard_get_keycode_ctx(&ctx, 0x04)) {
+    return 6;
+  }
+  layer_set_active_ctx(&ctx, 2, true);
+  if (check_key_ctx(&ctx, 7, true) != ERR_NONE ||
+      ctx.consumer_code != 0xE9) {
+    return 7;
+  }
+
+  // saving a loaded keymap gives the same bytes back
+  size_t again = 0;
+  if (keymap_save_ctx(&ctx, copy, sizeof(copy), &again) != ERR_NONE ||
+      again != written || memcmp(copy, saved, written) != 0) {
+    return 8;
+  }
+
+  // malformed keymaps are refused, and change nothing
+  const struct key *before = ctx.layers[0].keys;
+  struct {
+    size_t offset;
+    uint8_t value;
+  } corruptions[] = {
+      {0, 'X'},   // magic
+      {4, 2},     // version
+      {6, 41},    // key count
+      {8, 200},   // layer count
+      {12, 0xFF}, // size
+      {16, 9},    // kind of layer 0
+      {20, 2},    // offset of layer 0, misaligned
+      {24, 3},    // sparse layer 1 stores 3 keys, but has 2 bits
+      // the hold layer of the layer tap key 8 of layer 0
+      {40 + 8 * 4 + 3, SQUIRREL_LAYER_COUNT},
+      // the layer of the momentary key 3 of sparse layer 1
+      {40 + SQUIRREL_KEYCOUNT * 4 + SQUIRREL_KEYSTATE_WORDS * 4 + 2,
+       SQUIRREL_LAYER_COUNT},
+  };
+  for (size_t i = 0; i < sizeof(corruptions) / sizeof(corruptions[0]); i++) {
+    memcpy(copy, saved, written);
+    ((uint8_t *)copy)[corruptions[i].offset] = corruptions[i].value;
+    if (keymap_load_ctx(&ctx, copy, written) != ERR_KEYMAP_INVALID) {
+      return 9;
+    }
+  }
+  if (keymap_load_ctx(&ctx, saved, written - 1) != ERR_KEYMAP_INVALID) {
+    return 10; // truncated
+  }
+  memcpy((uint8_t *)copy + 1, saved, written);
+  if (keymap_load_ctx(&ctx, (uint8_t *)copy + 1, written) !=
+      ERR_KEYMAP_INVALID) {
+    return 11; // misaligned
+  }
+  if (ctx.layers[0].keys != before) {
+    return 12;
+  }
+
+  // switching layouts only swaps pointers
+  squirrel_init();
+  layer_set_keymap(0, dense);
+  layer_set_key(0, 1, keyboard(0x20));
+  if (keymap_save(copy, sizeof(copy), &written) != ERR_NONE ||
+      keymap_load_ctx(&ctx, copy, written) != ERR_NONE || !same_keys(&ctx)) {
+    return 13;
+  }
+  if (keymap_load_ctx(&ctx, saved, needed) != ERR_NONE ||
+      ctx.layers[1].keys == NULL) {
+    return 14;
+  }
+
+  // keys held across a load release what they pressed
+  check_key_ctx(&ctx, 0, false);
+  check_key_ctx(&ctx, 7, false);
+  layer_set_active_mask_ctx(&ctx, LAYER_BIT(0));
+  check_key_ctx(&ctx, 1, true);
+  if (!keyboard_get_keycode_ctx(&ctx, 0x05) ||
+      keymap_load_ctx(&ctx, copy, written) != ERR_NONE) {
+    return 15;
+  }
+  check_key_ctx(&ctx, 1, false);
+  if (keyboard_get_keycode_ctx(&ctx, 0x05) ||
+      keyboard_get_keycode_ctx(&ctx, 0x20)) {
+    return 16;
+  }
+  return 0;
+}
@@ -0,0 +1,63 @@
+#include "squirrel.h"
+#include "squirrel_ctx.h"
+#include "squirrel_init.h"
+#include "squirrel_key.h"
+#include "squirrel_keymap.h"
+#include "squirrel_quantum.h"
+#include <stdint.h>
+
+#define TOP (SQUIRREL_LAYER_COUNT - 1)
+
+// test: SQUIRREL_LAYER_COUNT - in squirrel_quantum.c. Built once per layer
+// count.
+int main() {
+  struct squirrel_ctx *ctx = &squirrel_default_ctx;
+  squirrel_init();
+
+  // the mask is as wide as the layer count needs, and at least a byte
+  uint8_t bits = sizeof(squirrel_layer_mask_t) * 8;
+  if (bits < SQUIRREL_LAYER_COUNT ||
+      (bits > 8 && bits / 2 >= SQUIRREL_LAYER_COUNT)) {
+    return 1;
+  }
+
+  // the top layer can be activated, and bits past it are ignored
+  layer_set_active(TOP, true);
+  if (ctx->active_layers != LAYER_BIT(TOP) || !ctx->layers[TOP].active) {
+    return 2;
+  }
+  layer_set_active_mask((squirrel_layer_mask_t)~0);
+  if (ctx->active_layers != LAYER_MASK_ALL || !ctx->layers[0].active) {
+    return 3;
+  }
+
+  // keys resolve through every layer
+  layer_set_key(0, 0, keyboard(0x05));
+  layer_set_key(TOP, 0, keyboard(0x04));
+  if (resolve_layer(0) != TOP) {
+    return 4;
+  }
+  layer_set_active(TOP, false);
+  if (resolve_layer(0) != 0) {
+    return 5;
+  }
+  if (press_key(0) != ERR_NONE || !keyboard_get_keycode(0x05)) {
+    return 6;
+  }
+  if (release_key(0) != ERR_NONE || keyboard_get_keycode(0x05)) {
+    return 7;
+  }
+
+  // layer actions reach the top layer
+  layer_set_key(0, 0, layer_toggle(TOP));
+  if (press_key(0) != ERR_NONE || !ctx->layers[TOP].active) {
+    return 8;
+  }
+  release_key(0);
+  layer_set_key(TOP, 0, layer_solo(TOP));
+  if (press_key(0) != ERR_NONE || ctx->active_layers != LAYER_BIT(TOP)) {
+    return 9;
+  }
+  release_key(0);
+  return 0;
+}
@@ -0,0 +1,72 @@
+#include "squirrel.h"
+#include "squirrel_init.h"
+#include "squirrel_key.h"
+#include "squirrel_keymap.h"
+#include "squirrel_quantum.h"
+#include <stdint.h>
+
+static const struct key base[SQUIRREL_KEYCOUNT] = {KEY_KEYBOARD(0x04),
+                                                   KEY_KEYBOARD(0x05)};
+
+// test: layer_set_keymap + layer_get_key + layer_set_key - in
+// squirrel_quantum.c
+int main() {
+  squirrel_init();
+
+  // without a base keymap, every key passes through
+  if (layer_get_key(0, 0).action != ACTION_PASSTHROUGH) {
+    return 1;
+  }
+
+  // the base keymap is read in place
+  layer_set_keymap(0, base);
+  if (layer_get_key(0, 1).action != ACTION_KEYBOARD ||
+      layer_get_key(0, 1).argument != 0x05) {
+    return 2;
+  }
+
+  // edits are consulted before the base keymap, which is left untouched
+  if (layer_set_key(0, 1, consumer(0xE9)) != ERR_NONE) {
+    return 3;
+  }
+  if (layer_get_key(0, 1).action != ACTION_CONSUMER ||
+      layer_get_key(0, 0).action != ACTION_KEYBOARD) {
+    return 4;
+  }
+  if (base[1].action != ACTION_KEYBOARD) {
+    return 5;
+  }
+
+  // the overlay has a fixed capacity (4 in this test), which setting a key
+  // back to its base keymap value frees up again
+  if (layer_set_key(1, 0, nop()) != ERR_NONE ||
+      layer_set_key(1, 1, nop()) != ERR_NONE ||
+      layer_set_key(2, 0, nop()) != ERR_NONE) {
+    return 6;
+  }
+  if (layer_set_key(2, 1, nop()) != ERR_KEYMAP_OVERLAY_FULL) {
+    return 7;
+  }
+  if (layer_set_key(0, 1, keyboard(0x05)) != ERR_NONE) {
+    return 8;
+  }
+  if (layer_set_key(2, 1, nop()) != ERR_NONE) {
+    return 9;
+  }
+  if (layer_get_key(0, 1).action != ACTION_KEYBOARD ||
+      layer_get_key(1, 0).action != ACTION_NOP ||
+      layer_get_key(1, 1).action != ACTION_NOP ||
+      layer_get_key(2, 0).action != ACTION_NOP ||
+      layer_get_key(2, 1).action != ACTION_NOP) {
+    return 10;
+  }
+
+  // replacing a base keymap forgets the layer's edits, and only those
+  layer_set_key(0, 0, nop());
+  layer_set_keymap(0, base);
+  if (layer_get_key(0, 0).action != ACTION_KEYBOARD ||
+      layer_get_key(1, 0).action != ACTION_NOP) {
+    return 11;
+  }
+  return 0;
+}
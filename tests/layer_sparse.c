@@ -0,0 +1,73 @@
+#include "squirrel.h"
+#include "squirrel_init.h"
+#include "squirrel_key.h"
+#include "squirrel_keymap.h"
+#include "squirrel_quantum.h"
+#include <stdint.h>
+
+// Layer 1 only has keys 3, 31, 32 and 39 (of 40), the rest pass through.
+static const uint32_t present[SQUIRREL_KEYSTATE_WORDS] = {
+    (1u << 3) | (1u << 31), (1u << 0) | (1u << 7)};
+static const struct key sparse[] = {KEY_KEYBOARD(0x03), KEY_KEYBOARD(0x1F),
+                                    KEY_KEYBOARD(0x20), KEY_KEYBOARD(0x27)};
+
+// test: layer_set_sparse_keymap + layer_get_key + resolve_layer - in
+// squirrel_quantum.c
+int main() {
+  squirrel_init();
+  struct key dense[SQUIRREL_KEYCOUNT];
+  for (int i = 0; i < SQUIRREL_KEYCOUNT; i++) {
+    dense[i] = nop();
+  }
+  layer_set_keymap(0, dense);
+  layer_set_sparse_keymap(1, present, sparse);
+  layer_set_active(0, true);
+  layer_set_active(1, true);
+
+  // present keys are found in the packed array, across words
+  uint8_t present_keys[] = {3, 31, 32, 39};
+  for (uint8_t i = 0; i < sizeof(present_keys); i++) {
+    struct key key = layer_get_key(1, present_keys[i]);
+    if (key.action != ACTION_KEYBOARD || key.argument != present_keys[i]) {
+      return 1;
+    }
+    if (resolve_layer(present_keys[i]) != 1) {
+      return 2;
+    }
+  }
+
+  // every other key passes through to the dense layer below
+  for (uint8_t i = 0; i < SQUIRREL_KEYCOUNT; i++) {
+    if (i == 3 || i == 31 || i == 32 || i == 39) {
+      continue;
+    }
+    if (layer_get_key(1, i).action != ACTION_PASSTHROUGH) {
+      return 3;
+    }
+    if (resolve_layer(i) != 0) {
+      return 4;
+    }
+  }
+
+  // runtime edits apply to sparse layers too
+  layer_set_key(1, 4, consumer(0xE9));
+  layer_set_key(1, 32, passthrough());
+  if (resolve_layer(4) != 1 || layer_get_key(1, 4).action != ACTION_CONSUMER) {
+    return 5;
+  }
+  if (resolve_layer(32) != 0) {
+    return 6;
+  }
+  if (layer_get_key(1, 39).argument != 0x27) {
+    return 7;
+  }
+
+  // pressing goes through the sparse layer
+  if (press_key(39) != ERR_NONE || !keyboard_get_keycode(0x27)) {
+    return 8;
+  }
+  if (release_key(39) != ERR_NONE || keyboard_get_keycode(0x27)) {
+    return 9;
+  }
+  return 0;
+}
@@ -0,0 +1,173 @@
+#include "squirrel.h"
+#include "squirrel_init.h"
+#include "squirrel_key.h"
+#include "squirrel_keyboard.h"
+#include "squirrel_keymap.h"
+#include "squirrel_macro.h"
+#include "squirrel_quantum.h"
+#include "squirrel_report.h"
+#include <stdint.h>
+
+#define SHIFT 0x02
+#define A 0x04
+#define B 0x05
+#define X 0x1B
+#define ONE 0x1E
+#define ENTER 0x28
+
+static const uint8_t typed[] = {MACRO_TEXT_START 'a', 'B', MACRO_TEXT_END
+                                    MACRO_TAP_KEY(ENTER) MACRO_END};
+static const uint8_t held[] = {MACRO_PRESS_KEY(X) MACRO_WAIT(2)
+                                   MACRO_RELEASE_KEY(X) MACRO_END};
+static const uint8_t tap[] = {MACRO_TAP_KEY(ONE) MACRO_END};
+static const uint8_t broken[] = {0x7F, MACRO_END};
+static const uint8_t skipped[] = {MACRO_TEXT_START 0x01, 'a', MACRO_TEXT_END
+                                      MACRO_END};
+static const uint8_t *const macros[] = {typed, held, tap, broken, skipped};
+#define MACRO_COUNT (sizeof(macros) / sizeof(macros[0]))
+
+// generation counts the changes to the keycodes and modifiers.
+uint32_t generation(void) {
+  return squirrel_report_generation(REPORT_KEYBOARD) +
+         squirrel_report_generation(REPORT_MODIFIERS);
+}
+
+// changes calls macro_step, and returns the number of changes it made to the
+// keyboard report, which must be at most 1.
+uint32_t changes(void) {
+  uint32_t before = generation();
+  if (macro_step() != ERR_NONE) {
+    return 2;
+  }
+  return generation() - before;
+}
+
+// test: macro_press + macro_play + macro_step - in squirrel_macro.c
+int main() {
+  squirrel_init();
+  macro_set_table(macros, MACRO_COUNT);
+  layer_set_active(0, true);
+  layer_set_key(0, 0, macro(0));
+
+  // pressing a macro key only queues the macro
+  uint32_t before = generation();
+  if (check_key(0, true) != ERR_NONE || !macro_playing() ||
+      generation() != before) {
+    return 1;
+  }
+  check_key(0, false);
+
+  // each step makes one change: text, with shift around capitals, then a tap
+  if (changes() != 1 || !keyboard_get_keycode(A)) {
+    return 2;
+  }
+  if (changes() != 1 || keyboard_get_keycode(A)) {
+    return 3;
+  }
+  if (changes() != 1 || keyboard_get_modifiers() != SHIFT) {
+    return 4;
+  }
+  if (changes() != 1 || !keyboard_get_keycode(B) ||
+      keyboard_get_modifiers() != SHIFT) {
+    return 5;
+  }
+  if (changes() != 1 || keyboard_get_keycode(B)) {
+    return 6;
+  }
+  if (changes() != 1 || keyboard_get_modifiers() != 0) {
+    return 7;
+  }
+  if (changes() != 1 || !keyboard_get_keycode(ENTER)) {
+    return 8;
+  }
+  if (changes() != 1 || keyboard_get_keycode(ENTER)) {
+    return 9;
+  }
+  if (changes() != 0 || macro_playing()) {
+    return 10;
+  }
+
+  // delays wait for whole frames, while keys are still scanned
+  layer_set_key(0, 0, keyboard(A));
+  macro_play(1);
+  if (changes() != 1 || !keyboard_get_keycode(X)) {
+    return 11;
+  }
+  check_key(0, true);
+  if (changes() != 0 || !keyboard_get_keycode(A)) {
+    return 12;
+  }
+  check_key(0, false);
+  if (changes() != 0 || keyboard_get_keycode(A)) {
+    return 13;
+  }
+  if (changes() != 1 || keyboard_get_keycode(X)) {
+    return 14;
+  }
+  if (changes() != 0 || macro_playing()) {
+    return 15;
+  }
+
+  // macros queue up to SQUIRREL_MACRO_QUEUE_SIZE, and play in turn
+  for (int i = 0; i < SQUIRREL_MACRO_QUEUE_SIZE; i++) {
+    if (macro_play(2) != ERR_NONE) {
+      return 16;
+    }
+  }
+  if (macro_play(2) != ERR_MACRO_QUEUE_FULL) {
+    return 17;
+  }
+  for (int i = 0; i < SQUIRREL_MACRO_QUEUE_SIZE * 2; i++) {
+    if (changes() != 1 || keyboard_get_keycode(ONE) != (i % 2 == 0)) {
+      return 18;
+    }
+  }
+  if (changes() != 0 || macro_playing()) {
+    return 19;
+  }
+
+  // shift that is already held is left alone
+  keyboard_activate_modifier(SHIFT);
+  macro_play(0);
+  changes(); // a
+  changes();
+  if (changes() != 1 || !keyboard_get_keycode(B) || changes() != 1 ||
+      keyboard_get_modifiers() != SHIFT) {
+    return 20;
+  }
+  changes(); // enter
+  changes();
+  keyboard_deactivate_modifier(SHIFT);
+
+  // characters that cannot be typed are skipped
+  macro_play(4);
+  if (changes() != 1 || !keyboard_get_keycode(A)) {
+    return 21;
+  }
+  changes();
+
+  // unknown macros and instructions are errors
+  if (macro_play(5) != ERR_MACRO_INVALID) {
+    return 22;
+  }
+  macro_play(3);
+  if (macro_step() != ERR_MACRO_INVALID || macro_playing()) {
+    return 23;
+  }
+
+  // the table is kept while a macro plays, so it can release what it pressed
+  macro_play(1);
+  changes();
+  if (macro_set_table(macros, 1) != ERR_MACRO_PLAYING ||
+      !keyboard_get_keycode(X)) {
+    return 24;
+  }
+  while (macro_playing()) {
+    changes();
+  }
+  if (keyboard_get_keycode(X) || macro_set_table(macros, 1) != ERR_NONE ||
+      macro_play(1) != ERR_MACRO_INVALID) {
+    return 25;
+  }
+  return 0;
+}
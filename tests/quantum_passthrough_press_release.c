@@ -1,30 +1,34 @@
 #include "squirrel.h"
+#include "squirrel_ctx.h"
 #include "squirrel_init.h"
 #include "squirrel_key.h"
+#include "squirrel_keymap.h"
 #include "squirrel_quantum.h"
 #include <stdlib.h>
 
 uint8_t test_result = 1; // 0 = pass, 1 = fail
 bool bad_test = false;   // true = fail
 
-enum squirrel_error test_press(uint8_t layer, uint8_t key_index, void *arg) {
+enum squirrel_error test_press(struct squirrel_ctx *ctx, uint8_t layer,
+                               uint8_t key_index, uint16_t arg) {
   test_result = 0;
   return ERR_NONE;
 }
 
-enum squirrel_error test_release(uint8_t layer, uint8_t key_index, void *arg) {
+enum squirrel_error test_release(struct squirrel_ctx *ctx, uint8_t layer,
+                                 uint8_t key_index, uint16_t arg) {
   test_result = 0;
   return ERR_NONE;
 }
 
-enum squirrel_error bad_test_press(uint8_t layer, uint8_t key_index,
-                                   void *arg) {
+enum squirrel_error bad_test_press(struct squirrel_ctx *ctx, uint8_t layer,
+                                   uint8_t key_index, uint16_t arg) {
   bad_test = true;
   return ERR_NONE;
 }
 
-enum squirrel_error bad_test_release(uint8_t layer, uint8_t key_index,
-                                     void *arg) {
+enum squirrel_error bad_test_release(struct squirrel_ctx *ctx, uint8_t layer,
+                                     uint8_t key_index, uint16_t arg) {
   bad_test = true;
   return ERR_NONE;
 }
@@ -35,18 +39,15 @@ enum squirrel_error bad_test_release(uint8_t layer, uint8_t key_index,
 int main() {
   squirrel_init();
 
-  struct key testkey;
-  testkey.pressed = test_press;
-  testkey.released = test_release;
-  layers[0].keys[0] = testkey; // When testkey is pressed, the test is passing.
+  custom_actions[0] = (struct action){test_press, test_release};
+  struct key testkey = custom(0, 0);
+  layer_set_key(0, 0, testkey); // When testkey is pressed, the test is passing.
 
-  struct key passthroughkey;
-  passthroughkey.pressed = quantum_passthrough_press;
-  passthroughkey.released = quantum_passthrough_release;
-  layers[1].keys[0] = passthroughkey; // This is the key being tested.
+  struct key passthroughkey = passthrough();
+  layer_set_key(1, 0, passthroughkey); // This is the key being tested.
 
-  layers[0].active = true;
-  layers[1].active = true;
+  layer_set_active(0, true);
+  layer_set_active(1, true);
 
   // Passthrough should press the key below it.
   enum squirrel_error err = press_key(0); // Press the key.
@@ -67,18 +68,17 @@ int main() {
   }
 
   // Passthrough should fall through inactive layers
-  layers[0].active = true; // this layer contains the testkey.
-  layers[1].active =
-      false; // this layer contains the badtestkey and should be ignored.
-  layers[2].active = true; // this layer contains the passthrough key.
-
-  layers[2].keys[0] = passthroughkey;
-
-  struct key badtestkey;
-  badtestkey.pressed = bad_test_press;
-  badtestkey.released = bad_test_release;
-  layers[1].keys[0] = badtestkey; // When badtestkey is pressed, the test is
-                                  // failing.
+  layer_set_active(0, true); // this layer contains the testkey.
+  layer_set_active(
+      1, false); // this layer contains the badtestkey and should be ignored.
+  layer_set_active(2, true); // this layer contains the passthrough key.
+
+  layer_set_key(2, 0, passthroughkey);
+
+  custom_actions[1] = (struct action){bad_test_press, bad_test_release};
+  struct key badtestkey = custom(1, 0);
+  layer_set_key(1, 0, badtestkey); // When badtestkey is pressed, the test is
+                                   // failing.
 
   test_result = 1;       // Reset the test result to failing again.
   err = press_key(0);    // Press the key.
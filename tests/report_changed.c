@@ -0,0 +1,70 @@
+#include "squirrel_consumer.h"
+#include "squirrel_keyboard.h"
+#include "squirrel_report.h"
+#include <stdint.h>
+
+// test: squirrel_report_changed + squirrel_report_generation - in
+// squirrel_report.c
+int main() {
+  // nothing has changed yet
+  if (squirrel_report_changed() != 0) {
+    return 1;
+  }
+
+  // activating a keycode marks the keyboard report as changed, once
+  keyboard_activate_keycode(0x04);
+  if (squirrel_report_changed() != REPORT_CHANGED(REPORT_KEYBOARD)) {
+    return 2;
+  }
+  if (squirrel_report_changed() != 0) {
+    return 3;
+  }
+  if (squirrel_report_generation(REPORT_KEYBOARD) != 1) {
+    return 4;
+  }
+
+  // activating an active keycode, or deactivating an inactive one, changes
+  // nothing
+  keyboard_activate_keycode(0x04);
+  keyboard_deactivate_keycode(0x05);
+  if (squirrel_report_changed() != 0 ||
+      squirrel_report_generation(REPORT_KEYBOARD) != 1) {
+    return 5;
+  }
+  keyboard_deactivate_keycode(0x04);
+  if (squirrel_report_changed() != REPORT_CHANGED(REPORT_KEYBOARD) ||
+      squirrel_report_generation(REPORT_KEYBOARD) != 2) {
+    return 6;
+  }
+
+  // modifiers are tracked separately
+  keyboard_activate_modifier(0b00000011);
+  keyboard_activate_modifier(0b00000001);
+  if (squirrel_report_changed() != REPORT_CHANGED(REPORT_MODIFIERS) ||
+      squirrel_report_generation(REPORT_MODIFIERS) != 1) {
+    return 7;
+  }
+  keyboard_deactivate_modifier(0b00000011);
+  keyboard_deactivate_modifier(0b00000010);
+  if (squirrel_report_changed() != REPORT_CHANGED(REPORT_MODIFIERS) ||
+      squirrel_report_generation(REPORT_MODIFIERS) != 2) {
+    return 8;
+  }
+
+  // the consumer code only changes when a different code is set or the
+  // active code is cleared
+  consumer_activate_consumer_code(0xE9);
+  consumer_activate_consumer_code(0xE9);
+  consumer_deactivate_consumer_code(0xEA);
+  if (squirrel_report_changed() != REPORT_CHANGED(REPORT_CONSUMER) ||
+      squirrel_report_generation(REPORT_CONSUMER) != 1) {
+    return 9;
+  }
+  consumer_deactivate_consumer_code(0xE9);
+  keyboard_activate_keycode(0x04);
+  if (squirrel_report_changed() !=
+      (REPORT_CHANGED(REPORT_CONSUMER) | REPORT_CHANGED(REPORT_KEYBOARD))) {
+    return 10;
+  }
+  return 0;
+}
@@ -0,0 +1,151 @@
+#include "squirrel.h"
+#include "squirrel_consumer.h"
+#include "squirrel_init.h"
+#include "squirrel_keyboard.h"
+#include "squirrel_report.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SHIFT 0x02
+#define CTRL 0x01
+#define A 0x04
+#define B 0x05
+
+struct squirrel_report_snapshot report;
+
+// has_keycode returns true if the keycode is pressed in report.
+bool has_keycode(uint8_t keycode) {
+  return (report.keyboard.keycodes[keycode / 8] >> (keycode % 8)) & 1;
+}
+
+// test: squirrel_report_frame + squirrel_report_transition - in
+// squirrel_report.c
+int main() {
+  squirrel_init();
+
+  // without frames, each frame is the current state
+  keyboard_activate_keycode(A);
+  keyboard_deactivate_keycode(A);
+  if (squirrel_report_frame(&report) || has_keycode(A)) {
+    return 1; // the tap is lost
+  }
+  keyboard_activate_keycode(A);
+  if (!squirrel_report_frame(&report) || !has_keycode(A)) {
+    return 2;
+  }
+
+  // enabling frames starts from the current state
+  squirrel_report_frame_enable(true);
+  if (squirrel_report_frame(&report) || !has_keycode(A)) {
+    return 3;
+  }
+  keyboard_deactivate_keycode(A);
+  squirrel_report_frame(&report);
+
+  // a tap between two frames is sent over two frames
+  keyboard_activate_keycode(A);
+  keyboard_deactivate_keycode(A);
+  if (!squirrel_report_frame(&report) || !has_keycode(A)) {
+    return 4;
+  }
+  if (!squirrel_report_frame(&report) || has_keycode(A)) {
+    return 5;
+  }
+  if (squirrel_report_frame(&report)) {
+    return 6;
+  }
+
+  // changes to different keys are merged into one frame
+  keyboard_activate_modifier(SHIFT);
+  keyboard_activate_modifier(CTRL);
+  keyboard_activate_keycode(A);
+  keyboard_activate_keycode(B);
+  if (!squirrel_report_frame(&report) || !has_keycode(A) || !has_keycode(B) ||
+      report.keyboard.modifiers != (SHIFT | CTRL)) {
+    return 7;
+  }
+  if (squirrel_report_frame(&report)) {
+    return 8;
+  }
+
+  // a frame ends at the first change to a key already changed in it, and
+  // keeps the order of the changes
+  keyboard_deactivate_keycode(A);
+  keyboard_deactivate_modifier(SHIFT);
+  keyboard_activate_keycode(A);
+  keyboard_deactivate_keycode(B);
+  keyboard_activate_modifier(SHIFT);
+  if (!squirrel_report_frame(&report) || has_keycode(A) || !has_keycode(B) ||
+      report.keyboard.modifiers != CTRL) {
+    return 9;
+  }
+  if (!squirrel_report_frame(&report) || !has_keycode(A) || has_keycode(B) ||
+      report.keyboard.modifiers != CTRL) {
+    return 10;
+  }
+  if (!squirrel_report_frame(&report) ||
+      report.keyboard.modifiers != (SHIFT | CTRL)) {
+    return 11;
+  }
+  keyboard_deactivate_keycode(A);
+  keyboard_deactivate_modifier(SHIFT | CTRL);
+  squirrel_report_frame(&report);
+
+  // a modifier change after a keycode press waits for the next frame, so "a"
+  // then shift is not sent as "A"
+  keyboard_activate_keycode(A);
+  keyboard_activate_modifier(SHIFT);
+  if (!squirrel_report_frame(&report) || !has_keycode(A) ||
+      report.keyboard.modifiers != 0) {
+    return 12;
+  }
+  if (!squirrel_report_frame(&report) || report.keyboard.modifiers != SHIFT) {
+    return 13;
+  }
+  // and so does a keycode release after a modifier change, which keeps their
+  // order
+  keyboard_deactivate_modifier(SHIFT);
+  keyboard_deactivate_keycode(A);
+  if (!squirrel_report_frame(&report) || !has_keycode(A) ||
+      report.keyboard.modifiers != 0) {
+    return 14;
+  }
+  if (!squirrel_report_frame(&report) || has_keycode(A)) {
+    return 15;
+  }
+
+  // consumer codes change once per frame
+  consumer_activate_consumer_code(0xE9);
+  consumer_activate_consumer_code(0xEA);
+  consumer_deactivate_consumer_code(0xEA);
+  if (!squirrel_report_frame(&report) || report.consumer_code != 0xE9) {
+    return 16;
+  }
+  if (!squirrel_report_frame(&report) || report.consumer_code != 0xEA) {
+    return 17;
+  }
+  if (!squirrel_report_frame(&report) || report.consumer_code != 0) {
+    return 18;
+  }
+
+  // once the queue overflows, the next frame is the current state
+  for (int i = 0; i < SQUIRREL_REPORT_QUEUE_SIZE; i++) {
+    keyboard_activate_keycode(A);
+    keyboard_deactivate_keycode(A);
+  }
+  keyboard_activate_keycode(B);
+  if (!squirrel_report_frame(&report) || has_keycode(A) || !has_keycode(B)) {
+    return 19;
+  }
+  if (squirrel_report_frame(&report)) {
+    return 20;
+  }
+
+  // the changes are still marked for squirrel_report_changed
+  squirrel_report_changed();
+  keyboard_deactivate_keycode(B);
+  if (squirrel_report_changed() != REPORT_CHANGED(REPORT_KEYBOARD)) {
+    return 21;
+  }
+  return 0;
+}
@@ -0,0 +1,49 @@
+#include "squirrel_consumer.h"
+#include "squirrel_keyboard.h"
+#include "squirrel_report.h"
+#include <stdint.h>
+
+// test: squirrel_report_publish + squirrel_report_read - in squirrel_report.c
+int main() {
+  struct squirrel_report_snapshot snapshot;
+
+  // before anything is published, the snapshot is empty
+  keyboard_activate_keycode(0x04);
+  if (squirrel_report_read(&snapshot) != 0) {
+    return 1;
+  }
+  if (snapshot.keyboard.keycodes[0] != 0 || snapshot.consumer_code != 0) {
+    return 2;
+  }
+
+  // publishing copies the current state
+  keyboard_activate_modifier(0b00000010);
+  consumer_activate_consumer_code(0xE9);
+  squirrel_report_publish();
+  if (squirrel_report_read(&snapshot) != 1) {
+    return 3;
+  }
+  if (snapshot.keyboard.keycodes[0] != 1 << 4 ||
+      snapshot.keyboard.modifiers != 0b00000010 ||
+      snapshot.consumer_code != 0xE9) {
+    return 4;
+  }
+
+  // later changes are not visible until they are published
+  keyboard_deactivate_keycode(0x04);
+  consumer_deactivate_consumer_code(0xE9);
+  if (squirrel_report_read(&snapshot) != 1 ||
+      snapshot.keyboard.keycodes[0] != 1 << 4) {
+    return 5;
+  }
+  squirrel_report_publish();
+  if (squirrel_report_read(&snapshot) != 2) {
+    return 6;
+  }
+  if (snapshot.keyboard.keycodes[0] != 0 ||
+      snapshot.keyboard.modifiers != 0b00000010 ||
+      snapshot.consumer_code != 0) {
+    return 7;
+  }
+  return 0;
+}
@@ -0,0 +1,85 @@
+#include "squirrel_consumer.h"
+#include "squirrel_ctx.h"
+#include "squirrel_keyboard.h"
+#include "squirrel_report.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define SNAPSHOTS 1000000
+
+uint32_t reads = 0;
+uint32_t torn_at = 0;
+bool torn = false;
+
+// Snapshot n has every report byte set to n % 256 and the consumer code set to
+// n % 65536, so a reader can tell if it saw parts of two snapshots.
+void *publish(void *arg) {
+  (void)arg;
+  for (uint32_t n = 1; n <= SNAPSHOTS; n++) {
+    memset(&squirrel_default_ctx.keyboard_report, n % 256,
+           sizeof(squirrel_default_ctx.keyboard_report));
+    squirrel_default_ctx.consumer_code = n % 65536;
+    squirrel_report_publish();
+    if (n % 64 == 0) {
+      sched_yield(); // Interleave with the reader even on a single core.
+    }
+  }
+  return NULL;
+}
+
+void *read_reports(void *arg) {
+  (void)arg;
+  uint32_t last = 0;
+  while (last < SNAPSHOTS) {
+    struct squirrel_report_snapshot snapshot;
+    uint32_t n = squirrel_report_read(&snapshot);
+    reads++;
+    if (n < last) {
+      torn = true;
+      torn_at = n;
+      return NULL;
+    }
+    if (n == last) {
+      sched_yield(); // Nothing new, let the publisher run.
+      continue;
+    }
+    const uint8_t *bytes = (const uint8_t *)&snapshot.keyboard;
+    for (size_t i = 0; i < sizeof(snapshot.keyboard); i++) {
+      if (bytes[i] != n % 256) {
+        torn = true;
+      }
+    }
+    if (snapshot.consumer_code != n % 65536) {
+      torn = true;
+    }
+    if (torn) {
+      torn_at = n;
+      return NULL;
+    }
+    last = n;
+  }
+  return NULL;
+}
+
+// test: squirrel_report_publish + squirrel_report_read from two threads - in
+// squirrel_report.c
+int main() {
+  pthread_t publisher_thread, reader_thread;
+  pthread_create(&reader_thread, NULL, read_reports, NULL);
+  pthread_create(&publisher_thread, NULL, publish, NULL);
+  pthread_join(publisher_thread, NULL);
+  pthread_join(reader_thread, NULL);
+
+  if (torn) {
+    printf("torn or stale snapshot %u after %u reads\n", torn_at, reads);
+    return 1;
+  }
+  if (reads == 0) {
+    return 2;
+  }
+  return 0;
+}
@@ -0,0 +1,81 @@
+#include "squirrel.h"
+#include "squirrel_ctx.h"
+#include "squirrel_init.h"
+#include "squirrel_key.h"
+#include "squirrel_keymap.h"
+#include "squirrel_quantum.h"
+#include <stdint.h>
+
+// test: resolve_layer + layer_set_key + layer_set_keymap +
+// layer_invalidate_cache - in squirrel_quantum.c
+int main() {
+  squirrel_init();
+
+  // no configured layers are active
+  if (resolve_layer(0) != LAYER_NONE) {
+    return 1;
+  }
+
+  // a single active layer of passthrough keys resolves to itself
+  layer_set_active(0, true);
+  if (resolve_layer(0) != 0) {
+    return 2;
+  }
+
+  // passthrough keys are skipped
+  layer_set_active(3, true);
+  layer_set_active(5, true);
+  layer_set_key(3, 0, nop());
+  if (resolve_layer(0) != 3) {
+    return 3;
+  }
+
+  // editing a key on an active layer updates the result
+  layer_set_key(5, 0, nop());
+  if (resolve_layer(0) != 5) {
+    return 4;
+  }
+
+  // changing the active layers updates the result
+  layer_set_active(5, false);
+  if (resolve_layer(0) != 3) {
+    return 5;
+  }
+  layer_set_active(3, false);
+  if (resolve_layer(0) != 0) {
+    return 6;
+  }
+
+  // editing a key on an inactive layer changes nothing until it is activated
+  layer_set_key(7, 0, nop());
+  if (resolve_layer(0) != 0) {
+    return 7;
+  }
+  layer_set_active(7, true);
+  if (resolve_layer(0) != 7) {
+    return 8;
+  }
+
+  // in place changes to a base keymap are picked up after
+  // layer_invalidate_cache
+  struct key keymap[SQUIRREL_KEYCOUNT] = {nop()};
+  layer_set_keymap(7, keymap);
+  if (resolve_layer(0) != 7) {
+    return 9;
+  }
+  keymap[0] = passthrough();
+  layer_invalidate_cache();
+  if (resolve_layer(0) != 0) {
+    return 10;
+  }
+
+  // deactivating every layer leaves nothing to resolve to
+  layer_set_active_mask(0);
+  if (squirrel_default_ctx.active_layers != 0) {
+    return 11;
+  }
+  if (resolve_layer(0) != LAYER_NONE) {
+    return 12;
+  }
+  return 0;
+}
@@ -0,0 +1,76 @@
+#ifndef SQUIRREL_TESTS_SCENARIO_H
+#define SQUIRREL_TESTS_SCENARIO_H
+
+// The fixture shared by the tests that play timed key presses and releases on
+// the default context. A test sets custom_actions[0] to record_press and
+// record_release, to see what its custom keys are pressed with.
+
+#include "squirrel.h"
+#include "squirrel_init.h"
+#include "squirrel_key.h"
+#include "squirrel_keyboard.h"
+#include "squirrel_timer.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SHIFT 0x02
+#define A 0x04
+
+static uint32_t now = 0;
+static uint8_t presses = 0;
+static uint8_t releases = 0;
+static uint16_t seen_arg = 0xFFFF;
+static squirrel_key_index_t seen_key_index = 0;
+static uint8_t seen_modifiers = 0;
+static bool seen_a = false;
+
+// record_press records the press, with the modifiers and whether A was active.
+static enum squirrel_error record_press(struct squirrel_ctx *ctx,
+                                        uint8_t layer,
+                                        squirrel_key_index_t key_index,
+                                        uint16_t arg) {
+  (void)ctx;
+  (void)layer;
+  presses++;
+  seen_arg = arg;
+  seen_key_index = key_index;
+  seen_modifiers = keyboard_get_modifiers();
+  seen_a = keyboard_get_keycode(A);
+  return ERR_NONE;
+}
+
+static enum squirrel_error record_release(struct squirrel_ctx *ctx,
+                                          uint8_t layer,
+                                          squirrel_key_index_t key_index,
+                                          uint16_t arg) {
+  (void)ctx;
+  (void)layer;
+  (void)key_index;
+  (void)arg;
+  releases++;
+  return ERR_NONE;
+}
+
+// scenario_start starts a scenario with nothing pressed and nothing recorded.
+static void scenario_start(void) {
+  squirrel_init();
+  now = 1000;
+  squirrel_tick(now);
+  presses = 0;
+  releases = 0;
+  seen_arg = 0xFFFF;
+  seen_key_index = 0;
+  seen_modifiers = 0;
+  seen_a = false;
+}
+
+// key presses or releases a key, then lets time pass.
+static bool key(squirrel_key_index_t key_index, bool pressed, uint32_t wait) {
+  if (check_key(key_index, pressed) != ERR_NONE) {
+    return false;
+  }
+  now += wait;
+  return squirrel_tick(now) == ERR_NONE;
+}
+
+#endif
@@ -0,0 +1,209 @@
+#include "scenario.h"
+#include "squirrel_ctx.h"
+#include "squirrel_keymap.h"
+#include "squirrel_quantum.h"
+#include "squirrel_report.h"
+#include <stdint.h>
+
+#define C 0x06
+
+// Key 0 is shift when held and A when tapped, key 1 records what it sees, and
+// key 2 is layer 1 when held and C when tapped. On layer 1, key 1 records
+// with a different argument.
+static const struct key base[SQUIRREL_KEYCOUNT] = {
+    KEY_MOD_TAP(SHIFT, A), KEY_CUSTOM(0, 0), KEY_LAYER_TAP(1, C)};
+static const struct key upper[SQUIRREL_KEYCOUNT] = {
+    KEY_PASSTHROUGH, KEY_CUSTOM(0, 1), KEY_PASSTHROUGH};
+
+struct layer *layers = squirrel_default_ctx.layers;
+
+// reset starts a scenario with nothing pressed, in the given mode.
+void reset(enum tap_hold_mode mode) {
+  scenario_start();
+  layer_set_keymap(0, base);
+  layer_set_keymap(1, upper);
+  layer_set_active(0, true);
+  tap_hold_set_mode(mode, 0);
+}
+
+// host_sees returns true if a host that polls the report after every change
+// would now be sent the keycode as pressed, or as released.
+bool host_sees(uint8_t keycode, bool pressed) {
+  return (squirrel_report_changed() & REPORT_CHANGED(REPORT_KEYBOARD)) &&
+         keyboard_get_keycode(keycode) == pressed;
+}
+
+// test: mod_tap + layer_tap + tap_hold_set_mode - in squirrel_quantum.c
+int main() {
+  custom_actions[0] = (struct action){record_press, record_release};
+
+  // released within the tapping term: a tap
+  reset(TAP_HOLD_TIMEOUT);
+  if (!key(0, true, SQUIRREL_TAPPING_TERM - 1)) {
+    return 1;
+  }
+  if (squirrel_report_changed() != 0) {
+    return 2; // undecided, so nothing is sent yet
+  }
+  if (!key(0, false, 0)) {
+    return 3;
+  }
+  if (!host_sees(A, true) || keyboard_get_modifiers() != 0) {
+    return 4; // A is pressed, and stays pressed until the next tick
+  }
+  squirrel_tick(++now);
+  if (!host_sees(A, false)) {
+    return 5;
+  }
+
+  // held for the tapping term: a hold
+  reset(TAP_HOLD_TIMEOUT);
+  if (!key(0, true, SQUIRREL_TAPPING_TERM) ||
+      keyboard_get_modifiers() != SHIFT) {
+    return 6;
+  }
+  if (!key(0, false, 0) || keyboard_get_modifiers() != 0 ||
+      keyboard_get_keycode(A)) {
+    return 7;
+  }
+
+  // other keys are held back until the key is decided, and see the result
+  reset(TAP_HOLD_TIMEOUT);
+  if (!key(0, true, 10) || !key(1, true, 10) || !key(1, false, 10)) {
+    return 8;
+  }
+  if (presses != 0 || releases != 0) {
+    return 9;
+  }
+  now += SQUIRREL_TAPPING_TERM;
+  squirrel_tick(now);
+  if (presses != 1 || releases != 1 || seen_modifiers != SHIFT) {
+    return 10;
+  }
+  key(0, false, 0);
+
+  // rolling off the key before the term: a tap, typed before the other key
+  reset(TAP_HOLD_TIMEOUT);
+  if (!key(0, true, 10) || !key(1, true, 10) || !key(0, false, 10)) {
+    return 11;
+  }
+  if (presses != 1 || seen_modifiers != 0 || !seen_a ||
+      keyboard_get_keycode(A)) {
+    return 12;
+  }
+  key(1, false, 0);
+
+  // permissive hold: another key tapped inside the key holds at once
+  reset(TAP_HOLD_PERMISSIVE_HOLD);
+  if (!key(0, true, 10) || !key(1, true, 10) || !key(1, false, 0)) {
+    return 13;
+  }
+  if (presses != 1 || releases != 1 || seen_modifiers != SHIFT) {
+    return 14;
+  }
+  key(0, false, 0);
+  if (keyboard_get_modifiers() != 0) {
+    return 15;
+  }
+
+  // permissive hold: but rolling off the key is still a tap
+  reset(TAP_HOLD_PERMISSIVE_HOLD);
+  if (!key(0, true, 10) || !key(1, true, 10) || !key(0, false, 10)) {
+    return 16;
+  }
+  if (presses != 1 || seen_modifiers != 0 || !seen_a) {
+    return 17;
+  }
+  key(1, false, 0);
+
+  // hold on other key press: any other press holds at once
+  reset(TAP_HOLD_ON_OTHER_KEY_PRESS);
+  if (!key(0, true, 10) || !key(1, true, 0)) {
+    return 18;
+  }
+  if (presses != 1 || seen_modifiers != SHIFT) {
+    return 19;
+  }
+  key(1, false, 0);
+  key(0, false, 0);
+
+  // a layer-tap hold activates its layer before the held back keys replay
+  reset(TAP_HOLD_PERMISSIVE_HOLD);
+  if (!key(2, true, 10) || !key(1, true, 10) || !key(1, false, 0)) {
+    return 20;
+  }
+  if (presses != 1 || seen_arg != 1 || !layers[1].active) {
+    return 21;
+  }
+  if (!key(2, false, 0) || layers[1].active || keyboard_get_keycode(C)) {
+    return 22;
+  }
+
+  // a layer-tap tap only types its keycode
+  reset(TAP_HOLD_TIMEOUT);
+  if (!key(2, true, 10) || !key(2, false, 0) || layers[1].active ||
+      !host_sees(C, true)) {
+    return 23;
+  }
+  squirrel_tick(++now);
+  if (!host_sees(C, false)) {
+    return 24;
+  }
+
+  // running out of room to hold events back decides a hold
+  reset(TAP_HOLD_TIMEOUT);
+  key(0, true, 1);
+  for (int i = 0; i < SQUIRREL_TAP_HOLD_BUFFER_SIZE / 2 + 1; i++) {
+    key(1, true, 1);
+    key(1, false, 1);
+  }
+  if (presses != SQUIRREL_TAP_HOLD_BUFFER_SIZE / 2 + 1 ||
+      seen_modifiers != SHIFT) {
+    return 25;
+  }
+  key(0, false, 0);
+
+  // the tapping term can be changed
+  reset(TAP_HOLD_TIMEOUT);
+  tap_hold_set_mode(TAP_HOLD_TIMEOUT, 20);
+  if (!key(0, true, 19) || keyboard_get_modifiers() != 0) {
+    return 26;
+  }
+  squirrel_tick(++now);
+  if (keyboard_get_modifiers() != SHIFT) {
+    return 27;
+  }
+
+  // an event that decides a key by filling the buffer waits behind a tap-hold
+  // key the replay leaves undecided
+  reset(TAP_HOLD_TIMEOUT);
+  for (int i = 0; i < SQUIRREL_TAP_HOLD_BUFFER_SIZE - 1; i++) {
+    layer_set_key(0, 3 + i, nop());
+  }
+  bool ok = key(2, true, 1) && key(0, true, 1);
+  for (int i = 0; i < SQUIRREL_TAP_HOLD_BUFFER_SIZE - 1; i++) {
+    ok = ok && key(3 + i, true, 1);
+  }
+  ok = ok && key(0, false, 1) && key(2, false, 1);
+  for (int i = 0; i < SQUIRREL_TAP_HOLD_BUFFER_SIZE - 1; i++) {
+    ok = ok && key(3 + i, false, 1);
+  }
+  now += SQUIRREL_TAPPING_TERM;
+  if (!ok || squirrel_tick(now) != ERR_NONE) {
+    return 28;
+  }
+  if (keyboard_get_modifiers() != 0 || keyboard_get_keycode(A) ||
+      layers[1].active) {
+    return 29;
+  }
+
+  // remapping an undecided key taps it, and its release does nothing more
+  reset(TAP_HOLD_TIMEOUT);
+  key(0, true, 10);
+  layer_set_key(0, 0, keyboard(C));
+  if (!key(0, false, SQUIRREL_TAPPING_TERM) || keyboard_get_modifiers() != 0 ||
+      keyboard_get_keycode(A) || keyboard_get_keycode(C)) {
+    return 30;
+  }
+  return 0;
+}
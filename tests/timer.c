@@ -0,0 +1,142 @@
+#include "squirrel.h"
+#include "squirrel_ctx.h"
+#include "squirrel_init.h"
+#include "squirrel_timer.h"
+#include <stdint.h>
+
+#define FIRES 64
+
+uint32_t fired_at[FIRES];
+uint16_t fired_arg[FIRES];
+uint8_t fired = 0;
+
+enum squirrel_error record(struct squirrel_ctx *ctx, uint16_t arg) {
+  fired_at[fired] = squirrel_now_ctx(ctx);
+  fired_arg[fired] = arg;
+  fired++;
+  return ERR_NONE;
+}
+
+// restart starts itself again, to check timers can be started while expiring.
+enum squirrel_error restart(struct squirrel_ctx *ctx, uint16_t arg) {
+  record(ctx, arg);
+  if (arg > 0) {
+    timer_start_ctx(ctx, 16, restart, arg - 1);
+  }
+  return ERR_NONE;
+}
+
+// cancel_other cancels the other timer of pair, if it is the first to run.
+uint8_t pair[2];
+enum squirrel_error cancel_other(struct squirrel_ctx *ctx, uint16_t arg) {
+  record(ctx, arg);
+  if (fired == 1) {
+    timer_cancel_ctx(ctx, pair[1 - arg]);
+  }
+  return ERR_NONE;
+}
+
+// test: timer_start + timer_cancel + squirrel_tick - in squirrel_timer.c
+int main() {
+  squirrel_init();
+
+  // time can jump ahead while nothing is pending
+  squirrel_tick(1000000);
+  if (squirrel_now() != 1000000) {
+    return 1;
+  }
+
+  // timers on every level fire exactly at their deadline, in order
+  uint16_t delays[] = {1, 15, 16, 255, 256, 257, 1000, 4095};
+  uint8_t count = sizeof(delays) / sizeof(delays[0]);
+  for (uint8_t i = 0; i < count; i++) {
+    if (timer_start(delays[i], record, i) == TIMER_NONE) {
+      return 2;
+    }
+  }
+  // one tick at a time, and in big steps, must give the same result
+  for (uint32_t t = 1000000; t <= 1000300; t++) {
+    squirrel_tick(t);
+  }
+  squirrel_tick(1005000);
+  if (fired != count) {
+    return 3;
+  }
+  for (uint8_t i = 0; i < count; i++) {
+    if (fired_arg[i] != i || fired_at[i] != 1000000u + delays[i]) {
+      return 4;
+    }
+  }
+
+  // a cancelled timer never fires, and its slot is reused
+  fired = 0;
+  uint8_t cancelled = timer_start(10, record, 1);
+  timer_start(10, record, 2);
+  timer_cancel(cancelled);
+  squirrel_tick(1005010);
+  if (fired != 1 || fired_arg[0] != 2) {
+    return 5;
+  }
+
+  // every timer can be in use at once, and then none is left
+  fired = 0;
+  for (uint8_t i = 0; i < SQUIRREL_TIMER_CAPACITY; i++) {
+    if (timer_start(100 + i * 300, record, i) == TIMER_NONE) {
+      return 6;
+    }
+  }
+  if (timer_start(1, record, 0) != TIMER_NONE) {
+    return 7;
+  }
+  squirrel_tick(1005010 + 100 + SQUIRREL_TIMER_CAPACITY * 300);
+  if (fired != SQUIRREL_TIMER_CAPACITY) {
+    return 8;
+  }
+
+  // delays past TIMER_MAX_DELAY are shortened to it
+  fired = 0;
+  uint32_t start = squirrel_now();
+  timer_start(UINT16_MAX, record, 0);
+  squirrel_tick(start + 70000);
+  if (fired != 1 || fired_at[0] != start + TIMER_MAX_DELAY) {
+    return 9;
+  }
+
+  // timer functions can start timers, even across the clock wrapping around
+  fired = 0;
+  squirrel_tick(UINT32_MAX - 20);
+  timer_start(1, restart, 3);
+  squirrel_tick(UINT32_MAX - 20 + 100);
+  if (fired != 4 || fired_at[3] != UINT32_MAX - 20 + 1 + 3 * 16) {
+    return 10;
+  }
+
+  // a timer expiring on the same tick can be cancelled before it runs
+  fired = 0;
+  pair[0] = timer_start(5, cancel_other, 0);
+  pair[1] = timer_start(5, cancel_other, 1);
+  squirrel_tick(squirrel_now() + 5);
+  if (fired != 1 || squirrel_default_ctx.timers.pending != 0) {
+    return 11;
+  }
+  // nothing is pending, so time skips ahead, and every timer is free once
+  squirrel_tick(squirrel_now() + 100000);
+  fired = 0;
+  uint8_t timers[SQUIRREL_TIMER_CAPACITY];
+  for (uint8_t i = 0; i < SQUIRREL_TIMER_CAPACITY; i++) {
+    timers[i] = timer_start(1, record, i);
+    for (uint8_t j = 0; j < i; j++) {
+      if (timers[i] == TIMER_NONE || timers[i] == timers[j]) {
+        return 12;
+      }
+    }
+  }
+  if (timer_start(1, record, 0) != TIMER_NONE) {
+    return 13;
+  }
+  squirrel_tick(squirrel_now() + 1);
+  if (fired != SQUIRREL_TIMER_CAPACITY) {
+    return 14;
+  }
+  return 0;
+}